@@ -0,0 +1,694 @@
+// Benchmark harness. Creates a hidden OpenGL context and runs the requested cases (all of them when none are given).
+// Run it from the repository root like the main executable: ./project_base_bench [case...]
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/model.h>
+#include <learnopengl/shader_variants.h>
+#include <Cube.h>
+#include <LightClusters.h>
+#include <Skybox.h>
+#include <Timer.h>
+#include <UniformBlocks.h>
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+const char *benchModels[] = {
+        "resources/objects/moai/moai.obj",
+        "resources/objects/lucy/Stanford's Lucy Angel.obj",
+        "resources/objects/venus/venus.obj",
+        "resources/objects/Spotlight.obj",
+        "resources/objects/CeilingLamp.obj",
+};
+
+const char *benchTextures[] = {
+        "resources/textures/floor.jpg",
+        "resources/textures/floor_specular.png",
+        "resources/textures/container.jpg",
+        "resources/textures/glass3.png",
+        "resources/textures/glass_specular.png",
+        "resources/objects/lucy/Stanford's Lucy Angel textures.jpg",
+        "resources/objects/backpack/ao.jpg",
+};
+
+void deleteModel(Model &model) {
+    TextureLoader::Instance().Finish();
+    model.ReleaseTextures();
+}
+
+// cold = Assimp import + cache write, warm = mapped cache upload
+void benchMeshCache() {
+    const int warmRuns = 5;
+    printf("%-52s %12s %12s %8s\n", "model", "cold [ms]", "warm [ms]", "speedup");
+    for (const char *path : benchModels) {
+        if (access(path, R_OK) != 0) {
+            printf("%-52s %12s\n", path, "missing");
+            continue;
+        }
+
+        MeshCache::Invalidate(path);
+        Timer timer;
+        {
+            Model model(path);
+            glFinish();
+            deleteModel(model);
+        }
+        double cold = timer.Milliseconds();
+
+        timer.Reset();
+        for (int i = 0; i < warmRuns; i++) {
+            Model model(path);
+            glFinish();
+            deleteModel(model);
+        }
+        double warm = timer.Milliseconds() / warmRuns;
+
+        printf("%-52s %12.2f %12.2f %7.1fx\n", path, cold, warm, cold / warm);
+    }
+}
+
+// known answers of the FIFO cache simulation behind the ACMR in the import report: a vertex is still cached after
+// VERTEX_CACHE_SIZE - 1 further misses and gone after VERTEX_CACHE_SIZE
+void benchVertexCache() {
+    std::vector<unsigned int> refill, evict;
+    for (int pass = 0; pass < 3; pass++)
+        for (unsigned int v = 0; v < VERTEX_CACHE_SIZE; v++)
+            refill.push_back(v);
+    for (unsigned int v = 0; v <= VERTEX_CACHE_SIZE; v++)
+        evict.push_back(v);
+    evict.push_back(0);
+    struct Check {
+        const char *name;
+        const std::vector<unsigned int> &indices;
+        float expected;
+    };
+    printf("%-52s %10s %10s\n", "sequence", "ACMR", "expected");
+    for (const Check &check : {Check{"cache size vertices, referenced three times", refill, 1.0f},
+                               Check{"one vertex more, then the first again", evict, 3.0f}}) {
+        float ratio = VertexCacheMissRatio(check.indices.data(), check.indices.size(), VERTEX_CACHE_SIZE + 1);
+        printf("%-52s %10.3f %10.3f%s\n", check.name, ratio, check.expected, ratio == check.expected ? "" : "  WRONG");
+    }
+}
+
+// CPU side import of the OBJ models through Assimp and through the native loader, without the mesh cache
+void benchObjLoader() {
+    const int runs = 3;
+    bool cacheEnabled = MeshCache::Enabled();
+    MeshCache::Enabled() = false;
+    printf("%-52s %12s %12s %8s %10s %10s\n", "model", "assimp [ms]", "native [ms]", "speedup", "vertices", "triangles");
+    for (const char *path : benchModels) {
+        if (access(path, R_OK) != 0) {
+            printf("%-52s %12s\n", path, "missing");
+            continue;
+        }
+
+        double milliseconds[2];
+        size_t vertices[2] = {0, 0}, triangles[2] = {0, 0};
+        for (int native = 0; native < 2; native++) {
+            ObjLoader::Enabled() = native != 0;
+            Timer timer;
+            for (int i = 0; i < runs; i++) {
+                ModelData data = Model::Import(path);
+                vertices[native] = triangles[native] = 0;
+                for (const MeshData &mesh : data.meshes) {
+                    vertices[native] += mesh.VertexCount();
+                    triangles[native] += mesh.lods.empty() ? mesh.IndexCount() / 3 : mesh.lods[0].indexCount / 3;
+                }
+            }
+            milliseconds[native] = timer.Milliseconds() / runs;
+        }
+        printf("%-52s %12.2f %12.2f %7.1fx %10zu %10zu\n", path, milliseconds[0], milliseconds[1],
+               milliseconds[0] / milliseconds[1], vertices[1], triangles[1]);
+        if (vertices[0] != vertices[1] || triangles[0] != triangles[1])
+            printf("%-52s assimp: %zu vertices, %zu triangles\n", "", vertices[0], triangles[0]);
+    }
+    ObjLoader::Enabled() = true;
+    MeshCache::Enabled() = cacheEnabled;
+}
+
+// Assimp's aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace, measured as the difference between reading with and
+// without them, against GenerateTangentFrames on the same corners on one thread and on the shared pool
+void benchTangentFrames() {
+    const int runs = 3;
+    const unsigned int assimpSteps = aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace;
+    ThreadPool singleThread(1);
+    printf("%-52s %12s %12s %12s %10s\n", "model", "assimp [ms]", "1 thread", "pool [ms]", "identical");
+    for (const char *path : benchModels) {
+        if (access(path, R_OK) != 0) {
+            printf("%-52s %12s\n", path, "missing");
+            continue;
+        }
+
+        double assimp = 0.0;
+        for (int i = 0; i < runs; i++) {
+            Assimp::Importer withSteps, withoutSteps;
+            Timer timer;
+            withSteps.ReadFile(path, MODEL_IMPORT_FLAGS | assimpSteps);
+            double with = timer.Milliseconds();
+            timer.Reset();
+            withoutSteps.ReadFile(path, MODEL_IMPORT_FLAGS);
+            assimp += (with - timer.Milliseconds()) / runs;
+        }
+
+        vector<MeshData> source;
+        ObjLoader::Load(path, source);
+        double milliseconds[2] = {0.0, 0.0};
+        vector<MeshData> results[2];
+        for (int pooled = 0; pooled < 2; pooled++) {
+            ThreadPool &pool = pooled ? ThreadPool::Shared() : singleThread;
+            for (int i = 0; i < runs; i++) {
+                vector<MeshData> meshes(source.size());
+                for (size_t m = 0; m < source.size(); m++) {
+                    meshes[m].vertices = source[m].vertices;
+                    meshes[m].indices = source[m].indices;
+                }
+                Timer timer;
+                for (MeshData &mesh : meshes)
+                    GenerateTangentFrames(mesh, pool);
+                milliseconds[pooled] += timer.Milliseconds() / runs;
+                results[pooled] = std::move(meshes);
+            }
+        }
+        bool identical = true;
+        for (size_t m = 0; m < source.size(); m++)
+            identical &= memcmp(results[0][m].vertices.data(), results[1][m].vertices.data(),
+                                results[0][m].vertices.size() * sizeof(Vertex)) == 0;
+        printf("%-52s %12.2f %12.2f %12.2f %10s\n", path, assimp, milliseconds[0], milliseconds[1], identical ? "yes" : "NO");
+    }
+}
+
+// time until the textures are resident with their full mip chain: decode + upload + glGenerateMipmap from the
+// sources, against the mip levels baked by project_base_bake
+void benchTextureStartup() {
+    const int runs = 3;
+    printf("%-60s %12s %12s %8s\n", "texture", "source [ms]", "baked [ms]", "speedup");
+    double totals[2] = {0.0, 0.0};
+    for (const char *path : benchTextures) {
+        if (access(path, R_OK) != 0) {
+            printf("%-60s %12s\n", path, "missing");
+            continue;
+        }
+        KtxFile baked;
+        if (!baked.OpenBaked(path, TextureLoader::FlipVertically())) {
+            printf("%-60s %12s\n", path, "not baked, run project_base_bake");
+            continue;
+        }
+
+        double milliseconds[2] = {0.0, 0.0};
+        for (int useBaked = 0; useBaked < 2; useBaked++) {
+            KtxFile::Enabled() = useBaked != 0;
+            for (int i = 0; i < runs; i++) {
+                Timer timer;
+                unsigned int textureID = TextureLoader::Instance().Load2D(path);
+                TextureLoader::Instance().Finish();
+                glFinish();
+                milliseconds[useBaked] += timer.Milliseconds() / runs;
+                TextureLoader::Instance().Forget(textureID);
+                glDeleteTextures(1, &textureID);
+            }
+            totals[useBaked] += milliseconds[useBaked];
+        }
+        printf("%-60s %12.2f %12.2f %7.1fx\n", path, milliseconds[0], milliseconds[1], milliseconds[0] / milliseconds[1]);
+    }
+    KtxFile::Enabled() = true;
+    if (totals[1] > 0.0)
+        printf("%-60s %12.2f %12.2f %7.1fx\n", "total", totals[0], totals[1], totals[0] / totals[1]);
+}
+
+// main thread cost of the texture uploads from client memory against the fenced pixel buffer ring, from the sources
+// so the uploads are large
+void benchPixelUpload() {
+    const int runs = 3;
+    KtxFile::Enabled() = false;
+    printf("%-20s %10s %12s %12s %14s\n", "uploads", "count", "MB", "MB/s", "ms per upload");
+    for (int staged = 0; staged < 2; staged++) {
+        PixelUploadRing::Enabled() = staged != 0;
+        PixelUploadRing::Stats before = TextureLoader::Instance().UploadStats();
+        for (int i = 0; i < runs; i++) {
+            std::vector<unsigned int> textureIDs;
+            for (const char *path : benchTextures)
+                if (access(path, R_OK) == 0)
+                    textureIDs.push_back(TextureLoader::Instance().Load2D(path));
+            TextureLoader::Instance().Finish();
+            glFinish();
+            for (unsigned int textureID : textureIDs) {
+                TextureLoader::Instance().Forget(textureID);
+                glDeleteTextures(1, &textureID);
+            }
+        }
+        PixelUploadRing::Stats after = TextureLoader::Instance().UploadStats();
+        PixelUploadRing::Stats run;
+        run.uploads = after.uploads - before.uploads;
+        run.bytes = after.bytes - before.bytes;
+        run.milliseconds = after.milliseconds - before.milliseconds;
+        printf("%-20s %10zu %12.2f %12.1f %14.3f\n", staged ? "pixel buffer ring" : "client memory", run.uploads,
+               run.bytes / 1048576.0, run.MegabytesPerSecond(), run.MillisecondsPerUpload());
+    }
+    PixelUploadRing::Enabled() = true;
+    KtxFile::Enabled() = true;
+}
+
+// the skybox from its six face images (decoded concurrently) against the baked single-file cubemap
+void benchSkybox() {
+    const int runs = 3;
+    std::vector<std::string> faces = skyboxFaces();
+    KtxFile baked;
+    bool haveBaked = baked.OpenBaked(faces, false);
+    printf("%-20s %12s %12s %12s\n", "skybox", "decode [ms]", "total [ms]", "MB");
+    for (int useBaked = 0; useBaked < (haveBaked ? 2 : 1); useBaked++) {
+        KtxFile::Enabled() = useBaked != 0;
+        double decode = 0.0, total = 0.0;
+        size_t bytes = 0;
+        for (int i = 0; i < runs; i++) {
+            Timer timer;
+            unsigned int textureID = TextureLoader::Instance().LoadCubemap(faces);
+            TextureLoader::Instance().Finish();
+            glFinish();
+            total += timer.Milliseconds() / runs;
+            decode += TextureLoader::Instance().GetLoadTime(textureID).decodeMilliseconds / runs;
+            bytes = TextureLoader::Instance().ResidentBytes(textureID);
+            TextureLoader::Instance().Forget(textureID);
+            glDeleteTextures(1, &textureID);
+        }
+        printf("%-20s %12.2f %12.2f %12.2f\n", useBaked ? "baked cubemap" : "face images", decode, total, bytes / 1048576.0);
+    }
+    KtxFile::Enabled() = true;
+    if (!haveBaked)
+        printf("%-20s %12s\n", "baked cubemap", "not baked, run project_base_bake");
+}
+
+// the scene's programs compiled from source against loaded from the program binary cache
+void benchShaderStartup() {
+    const int runs = 5;
+    const char *programs[][2] = {
+            {"resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs"},
+            {"resources/shaders/skybox.vs", "resources/shaders/skybox.fs"},
+            {"resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs"},
+    };
+    if (!ProgramBinaryCache::Instance().Supported()) {
+        printf("program binaries not supported by the driver\n");
+        return;
+    }
+    printf("%-40s %14s %12s %8s\n", "program", "compile [ms]", "load [ms]", "speedup");
+    for (const auto &program : programs) {
+        double milliseconds[2];
+        for (int cached = 0; cached < 2; cached++) {
+            ProgramBinaryCache::Enabled() = cached != 0;
+            if (cached) {
+                // writes the binary the timed runs load
+                Shader shader(program[0], program[1]);
+                glDeleteProgram(shader.ID);
+            }
+            Timer timer;
+            for (int i = 0; i < runs; i++) {
+                Shader shader(program[0], program[1]);
+                glFinish();
+                glDeleteProgram(shader.ID);
+            }
+            milliseconds[cached] = timer.Milliseconds() / runs;
+        }
+        printf("%-40s %14.2f %12.2f %7.1fx\n", program[0], milliseconds[0], milliseconds[1], milliseconds[0] / milliseconds[1]);
+    }
+    ProgramBinaryCache::Enabled() = true;
+}
+
+// CPU time of the uniform updates and model draws of a frame, with every location asked from the driver against
+// taken from the table reflected at link time. The camera moves every frame, its block is uploaded each time.
+void benchUniformUpdates() {
+    const int frames = 200;
+    Shader shader("resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs");
+    std::vector<Model *> models;
+    for (const char *path : benchModels)
+        if (access(path, R_OK) == 0)
+            models.push_back(new Model(path));
+    TextureLoader::Instance().Finish();
+    shader.BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    UniformBuffer<CameraBlock> cameraBuffer;
+    cameraBuffer.Create(CAMERA_BLOCK_BINDING);
+    shader.use();
+    printf("%-24s %14s %18s\n", "uniform locations", "frame [ms]", "queries per frame");
+    for (int cached = 0; cached < 2; cached++) {
+        Shader::CacheUniformLocations() = cached != 0;
+        size_t queries = Shader::LocationQueries();
+        double milliseconds = 0.0;
+        for (int frame = 0; frame < frames; frame++) {
+            Timer timer;
+            CameraBlock camera = {};
+            camera.projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+            camera.viewPos = glm::vec3(0.0f, 1.0f, 10.0f + 0.01f * frame);
+            camera.view = glm::lookAt(camera.viewPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            cameraBuffer.Update(camera);
+            shader.setInt("material.diffuseMap", 0);
+            shader.setInt("material.specularMap", 1);
+            shader.setInt("blending", 0);
+            for (Model *model : models) {
+                shader.setMat4("model", glm::mat4(1.0f));
+                model->Draw(shader);
+            }
+            milliseconds += timer.Milliseconds();
+            // the GPU work isn't part of the measurement
+            glFinish();
+        }
+        printf("%-24s %14.3f %18.1f\n", cached ? "reflected at link" : "glGetUniformLocation", milliseconds / frames,
+               (double) (Shader::LocationQueries() - queries) / frames);
+    }
+    Shader::CacheUniformLocations() = true;
+    cameraBuffer.Destroy();
+    for (Model *model : models) {
+        deleteModel(*model);
+        delete model;
+    }
+    glDeleteProgram(shader.ID);
+}
+
+// GPU time of the advanced_lighting fragment shader over full screen passes at 1080p, for growing light counts. The
+// spot lights either face the surface or face away from it, in which case the cone test skips them.
+void benchLightingKernel() {
+    const int width = 1920, height = 1080, passes = 20;
+    const char *diffusePath = "resources/textures/floor.jpg", *specularPath = "resources/textures/floor_specular.png";
+    if (access(diffusePath, R_OK) != 0 || access(specularPath, R_OK) != 0) {
+        printf("%-28s %12s\n", "floor textures", "missing");
+        return;
+    }
+    // hidden windows have no dependable default framebuffer
+    GLuint framebuffer, colorbuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+    glViewport(0, 0, width, height);
+
+    // a quad covering the screen with the camera at the origin, positions, normals and texture coordinates
+    float quad[] = {
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+            1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 4.0f, 0.0f,
+            1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 4.0f, 4.0f,
+            1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 4.0f, 4.0f,
+            -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 4.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+    };
+    GLuint VAO, VBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    ConfigureVAO(VAO, VBO, quad, sizeof(quad));
+
+    unsigned int diffuseMap = TextureLoader::Instance().Load2D(diffusePath);
+    unsigned int specularMap = TextureLoader::Instance().Load2D(specularPath);
+    TextureLoader::Instance().Finish();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, diffuseMap);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, specularMap);
+
+    Shader shader("resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs");
+    shader.BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    shader.BindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+    shader.use();
+    shader.setInt("material.diffuseMap", 0);
+    shader.setInt("material.specularMap", 1);
+    shader.setMat4("model", glm::mat4(1.0f));
+    UniformBuffer<CameraBlock> cameraBuffer;
+    UniformBuffer<LightsBlock> lightsBuffer;
+    cameraBuffer.Create(CAMERA_BLOCK_BINDING);
+    lightsBuffer.Create(LIGHTS_BLOCK_BINDING);
+    CameraBlock camera = {};
+    camera.projection = camera.view = camera.skyboxView = glm::mat4(1.0f);
+    camera.viewPos = glm::vec3(0.0f, 0.0f, 2.0f);
+    cameraBuffer.Update(camera);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    GLuint query;
+    glGenQueries(1, &query);
+    printf("%-28s %12s %14s\n", "lights", "ms per pass", "ns per pixel");
+    for (int lightCount : {1, 2, 6, 16}) {
+        for (int facing = 1; facing >= 0; facing--) {
+            if (lightCount <= 2 && !facing)
+                continue;
+            LightsBlock lights = {};
+            lights.Add(MakeDirectionalLight(glm::vec3(-0.4f, -0.5f, -1.0f), glm::vec3(0.05f), glm::vec3(0.3f), glm::vec3(0.2f)));
+            if (lightCount > 1)
+                lights.Add(MakePointLight(glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.1f), glm::vec3(0.4f), glm::vec3(0.5f),
+                                          1.0f, 0.045f, 0.0075f));
+            for (int i = 2; i < lightCount; i++) {
+                glm::vec3 position(-0.8f + 1.6f * (i - 2) / (lightCount - 2), 0.0f, 1.0f);
+                lights.Add(MakeSpotLight(position, glm::vec3(0.0f, 0.0f, facing ? -1.0f : 1.0f), 10.0f, 25.0f,
+                                         glm::vec3(0.25f), glm::vec3(1.0f), glm::vec3(1.0f), 1.0f, 0.045f, 0.0075f));
+            }
+            lightsBuffer.Update(lights);
+            // one pass untimed, so the timed ones don't include the first use of the program
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (int i = 0; i < passes; i++)
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            double pass = nanoseconds / 1e6 / passes;
+            char label[64];
+            snprintf(label, sizeof(label), "%d%s", lightCount, lightCount > 2 ? (facing ? ", spots lit" : ", spots culled") : "");
+            printf("%-28s %12.3f %14.3f\n", label, pass, pass * 1e6 / ((double) width * height));
+        }
+    }
+
+    glDeleteQueries(1, &query);
+    cameraBuffer.Destroy();
+    lightsBuffer.Destroy();
+    glDeleteProgram(shader.ID);
+    for (unsigned int textureID : {diffuseMap, specularMap}) {
+        TextureLoader::Instance().Forget(textureID);
+        glDeleteTextures(1, &textureID);
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &colorbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+// The CLUSTERED advanced_lighting variant over a 1080p view of a large floor lit by many small point lights, with the
+// lights assigned to a single cluster (every fragment walks all visible lights) and to the full cluster grid. Shows
+// the CPU time of the assignment, the list entries it produced and the GPU time of a pass.
+void benchClusteredLights() {
+    const int width = 1920, height = 1080, passes = 20, builds = 10;
+    const float near = 0.1f, far = 100.0f;
+    const char *diffusePath = "resources/textures/floor.jpg", *specularPath = "resources/textures/floor_specular.png";
+    if (access(diffusePath, R_OK) != 0 || access(specularPath, R_OK) != 0) {
+        printf("%-28s %12s\n", "floor textures", "missing");
+        return;
+    }
+    GLuint framebuffer, colorbuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+    glViewport(0, 0, width, height);
+
+    // a 40 x 40 floor, looked at from above one of its edges
+    float floor[] = {
+            -20.0f, 0.0f, -20.0f, 0.0f, 1.0f, 0.0f, 0.0f, 20.0f,
+            -20.0f, 0.0f, 20.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
+            20.0f, 0.0f, 20.0f, 0.0f, 1.0f, 0.0f, 20.0f, 0.0f,
+            20.0f, 0.0f, 20.0f, 0.0f, 1.0f, 0.0f, 20.0f, 0.0f,
+            20.0f, 0.0f, -20.0f, 0.0f, 1.0f, 0.0f, 20.0f, 20.0f,
+            -20.0f, 0.0f, -20.0f, 0.0f, 1.0f, 0.0f, 0.0f, 20.0f,
+    };
+    GLuint VAO, VBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    ConfigureVAO(VAO, VBO, floor, sizeof(floor));
+
+    unsigned int diffuseMap = TextureLoader::Instance().Load2D(diffusePath);
+    unsigned int specularMap = TextureLoader::Instance().Load2D(specularPath);
+    TextureLoader::Instance().Finish();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, diffuseMap);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, specularMap);
+
+    Shader shader("resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs", nullptr,
+                  ShaderVariant().Define("CLUSTERED", 1).defines);
+    shader.BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    LightClusters::Configure(shader);
+    shader.setInt("material.diffuseMap", 0);
+    shader.setInt("material.specularMap", 1);
+    shader.setMat4("model", glm::mat4(1.0f));
+    UniformBuffer<CameraBlock> cameraBuffer;
+    cameraBuffer.Create(CAMERA_BLOCK_BINDING);
+    CameraBlock camera = {};
+    camera.projection = glm::perspective(glm::radians(45.0f), (float) width / (float) height, near, far);
+    camera.viewPos = glm::vec3(0.0f, 4.0f, 22.0f);
+    camera.view = glm::lookAt(camera.viewPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    cameraBuffer.Update(camera);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    GLuint query;
+    glGenQueries(1, &query);
+    printf("%-28s %12s %12s %14s\n", "lights", "assign [ms]", "list entries", "ms per pass");
+    struct Grid {
+        const char *name;
+        unsigned int x, y, z;
+    };
+    for (Grid grid : {Grid{"one cluster", 1, 1, 1}, Grid{"16x9x24", CLUSTER_TILES_X, CLUSTER_TILES_Y, CLUSTER_SLICES}}) {
+        // one at a time, every LightClusters binds its own buffers to the same points
+        LightClusters clusters(grid.x, grid.y, grid.z);
+        clusters.Create();
+        for (int lightCount : {16, 64, 256, 1024}) {
+            std::mt19937 random(lightCount);
+            std::uniform_real_distribution<float> across(-20.0f, 20.0f), hue(0.0f, 6.28f);
+            std::vector<LightBlock> lights;
+            lights.push_back(MakeDirectionalLight(glm::vec3(-0.4f, -1.0f, -0.2f), glm::vec3(0.05f), glm::vec3(0.2f),
+                                                  glm::vec3(0.1f)));
+            for (int i = 0; i < lightCount; i++) {
+                float phase = hue(random);
+                glm::vec3 color = glm::vec3(cos(phase), cos(phase + 2.1f), cos(phase + 4.2f)) * 0.5f + glm::vec3(0.5f);
+                lights.push_back(MakePointLight(glm::vec3(across(random), 0.5f, across(random)), glm::vec3(0.0f),
+                                                color * 0.6f, color * 0.3f, 1.0f, 1.0f, 30.0f));
+            }
+            Timer timer;
+            for (int i = 0; i < builds; i++)
+                clusters.Build(lights, camera.view, camera.projection, near, far, width, height);
+            double assign = timer.Milliseconds() / builds;
+            clusters.Upload();
+
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (int i = 0; i < passes; i++)
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            char label[64];
+            snprintf(label, sizeof(label), "%d, %s", lightCount, grid.name);
+            printf("%-28s %12.3f %12zu %14.3f\n", label, assign, clusters.GetStats().indices, nanoseconds / 1e6 / passes);
+        }
+        clusters.Destroy();
+    }
+
+    glDeleteQueries(1, &query);
+    cameraBuffer.Destroy();
+    glDeleteProgram(shader.ID);
+    for (unsigned int textureID : {diffuseMap, specularMap}) {
+        TextureLoader::Instance().Forget(textureID);
+        glDeleteTextures(1, &textureID);
+    }
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteRenderbuffers(1, &colorbuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+}
+
+// what loading the scene's shaders, cached models and textures costs in system calls and copies, with the assets
+// read from single files and out of the resource pack
+void loadSceneAssets() {
+    const char *shaders[] = {"resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs",
+                             "resources/shaders/skybox.vs", "resources/shaders/skybox.fs",
+                             "resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs"};
+    for (const char *path : shaders)
+        AssetFile(path).text();
+    for (const char *path : benchModels)
+        if (access(path, R_OK) == 0)
+            Model::Import(path);
+    std::vector<unsigned int> textureIDs;
+    for (const char *path : benchTextures)
+        if (access(path, R_OK) == 0)
+            textureIDs.push_back(TextureLoader::Instance().Load2D(path));
+    TextureLoader::Instance().Finish();
+    for (unsigned int textureID : textureIDs) {
+        TextureLoader::Instance().Forget(textureID);
+        glDeleteTextures(1, &textureID);
+    }
+}
+
+void benchAssetReads() {
+    AssetFileSystem &fileSystem = AssetFileSystem::Instance();
+    AssetFileSystem::Stats &stats = fileSystem.GetStats();
+    fileSystem.Unmount();
+    // warms the page cache, so both variants read the same files from memory
+    loadSceneAssets();
+    printf("%-24s %10s %10s %12s %12s %12s %12s\n", "assets", "time [ms]", "file calls", "read calls", "read MB",
+           "copied MB", "from pack");
+    for (int packed = 0; packed < 2; packed++) {
+        if (packed && !fileSystem.Mount(AssetFileSystem::DefaultPackPath())) {
+            printf("%-24s %10s\n", "resource pack", "missing, run project_base_pack");
+            break;
+        }
+        size_t systemCalls = MappedFile::SystemCalls() + stats.stampChecks, copied = stats.copiedBytes, fromPack = stats.packOpens;
+        ProcessReads reads = currentProcessReads();
+        Timer timer;
+        loadSceneAssets();
+        double milliseconds = timer.Milliseconds();
+        ProcessReads after = currentProcessReads();
+        printf("%-24s %10.2f %10zu %12zu %12.2f %12.2f %12zu\n", packed ? "resource pack" : "single files", milliseconds,
+               MappedFile::SystemCalls() + stats.stampChecks - systemCalls, after.calls - reads.calls,
+               (after.bytes - reads.bytes) / 1048576.0, (stats.copiedBytes - copied) / 1048576.0, stats.packOpens - fromPack);
+    }
+}
+
+struct BenchmarkCase {
+    const char *name;
+    void (*run)();
+};
+
+BenchmarkCase benchmarkCases[] = {
+        {"mesh_cache", benchMeshCache},
+        {"vertex_cache", benchVertexCache},
+        {"obj_loader", benchObjLoader},
+        {"tangent_frames", benchTangentFrames},
+        {"texture_startup", benchTextureStartup},
+        {"pixel_upload", benchPixelUpload},
+        {"skybox", benchSkybox},
+        {"shader_startup", benchShaderStartup},
+        {"asset_reads", benchAssetReads},
+        {"uniform_updates", benchUniformUpdates},
+        {"lighting_kernel", benchLightingKernel},
+        {"clustered_lights", benchClusteredLights},
+};
+
+int main(int argc, char **argv) {
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow *window = glfwCreateWindow(800, 600, "bench", NULL, NULL);
+    if (window == NULL) {
+        printf("Failed to create GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
+        printf("Failed to initialize GLAD\n");
+        return -1;
+    }
+    ProgramBinaryCache::Instance().LoadEntryPoints((GLADloadproc) glfwGetProcAddress);
+    AssetFileSystem::Instance().Mount(AssetFileSystem::DefaultPackPath());
+    TextureLoader::FlipVertically() = true;
+
+    for (BenchmarkCase &benchmark : benchmarkCases) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++)
+            selected |= strcmp(argv[i], benchmark.name) == 0;
+        if (!selected)
+            continue;
+        printf("== %s\n", benchmark.name);
+        benchmark.run();
+    }
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,209 @@
+#ifndef PROJECT_BASE_ASSETFILESYSTEM_H
+#define PROJECT_BASE_ASSETFILESYSTEM_H
+
+#include <MappedFile.h>
+#include <ResourcePack.h>
+
+#include <atomic>
+#include <climits>
+#include <string>
+#include <utility>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// How every loader reads assets: a path is served from the mounted resource pack when the pack has it, and from a
+// memory mapping of the file on disk otherwise. Either way the loader gets a read-only span, nothing is copied.
+//
+// While CheckLooseFiles is on, a packed asset is only used if the file on disk is missing or still the one that
+// was packed (same size and modification time), so editing a shader or re-baking a texture doesn't need a new pack.
+// That costs one stat per asset; with it off, an asset in the pack costs no system call at all.
+//
+// Paths are looked up relative to the working directory the pack was made in; absolute paths under the current
+// working directory (like the ones FileSystem::getPath builds) are made relative first. Open is thread safe.
+class AssetFileSystem {
+public:
+    struct Stats {
+        std::atomic<size_t> packOpens{0};
+        std::atomic<size_t> diskOpens{0};
+        std::atomic<size_t> packBytes{0};    // served as spans of the pack
+        std::atomic<size_t> diskBytes{0};    // served as mappings of single files
+        std::atomic<size_t> copiedBytes{0};  // copied out of the spans by loaders that need their own buffer
+        std::atomic<size_t> stampChecks{0};  // stat calls comparing a packed asset with the file on disk
+    };
+
+    static AssetFileSystem &Instance() {
+        static AssetFileSystem fileSystem;
+        return fileSystem;
+    }
+
+    static bool &CheckLooseFiles() {
+        static bool check = true;
+        return check;
+    }
+
+    // the pack made by project_base_pack, found relative to the working directory
+    static std::string DefaultPackPath() {
+        return "resources/cache/resources.pack";
+    }
+
+    // before any asset is loaded; false when the pack is missing or invalid, assets then all come from disk
+    bool Mount(const std::string &packPath) {
+        char directory[PATH_MAX];
+        root = getcwd(directory, sizeof(directory)) ? std::string(directory) + '/' : std::string();
+        return pack.Open(packPath);
+    }
+
+    // only while nothing opened from the pack is in use anymore
+    void Unmount() {
+        pack = ResourcePack();
+    }
+
+    const ResourcePack &Pack() const {
+        return pack;
+    }
+
+    bool Exists(const std::string &path) const {
+        struct stat info;
+        return pack.Find(relative(path)) || stat(path.c_str(), &info) == 0;
+    }
+
+    // size and modification time (nanoseconds) of an asset without reading it: from the pack index for a packed
+    // asset, a stat otherwise; false when the asset doesn't exist
+    bool Stamp(const std::string &path, size_t &size, int64_t &modificationTime) {
+        if (const ResourcePack::Entry *entry = findPacked(path)) {
+            size = entry->size;
+            modificationTime = entry->sourceMtime;
+            return true;
+        }
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return false;
+        size = (size_t) info.st_size;
+        modificationTime = ResourcePack::ModificationTime(info);
+        return true;
+    }
+
+    Stats &GetStats() {
+        return stats;
+    }
+
+    // for loaders that have to copy an asset out of its span, so the report shows what zero-copy doesn't cover
+    void CountCopy(size_t bytes) {
+        stats.copiedBytes += bytes;
+    }
+
+private:
+    friend class AssetFile;
+
+    ResourcePack pack;
+    std::string root;
+    Stats stats;
+
+    AssetFileSystem() = default;
+
+    std::string relative(const std::string &path) const {
+        size_t start = 0;
+        if (!root.empty() && path.compare(0, root.size(), root) == 0)
+            start = root.size();
+        while (path.compare(start, 2, "./") == 0)
+            start += 2;
+        return path.substr(start);
+    }
+
+    const ResourcePack::Entry *findPacked(const std::string &path) {
+        if (!pack.IsOpen())
+            return nullptr;
+        const ResourcePack::Entry *entry = pack.Find(relative(path));
+        if (!entry || !CheckLooseFiles())
+            return entry;
+        stats.stampChecks++;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return entry;
+        bool unchanged = (size_t) info.st_size == entry->size && ResourcePack::ModificationTime(info) == entry->sourceMtime;
+        return unchanged ? entry : nullptr;
+    }
+};
+
+// An asset opened through AssetFileSystem. Used like MappedFile: data() stays valid for the lifetime of the object,
+// and for assets from the pack for as long as the pack is mounted.
+class AssetFile {
+public:
+    AssetFile() = default;
+
+    explicit AssetFile(const std::string &path) {
+        open(path);
+    }
+
+    AssetFile(AssetFile &&other) noexcept : mapped(std::move(other.mapped)), span(other.span), length(other.length),
+                                            packed(other.packed) {
+        other.span = nullptr;
+        other.length = 0;
+        other.packed = false;
+    }
+
+    AssetFile &operator=(AssetFile &&other) noexcept {
+        if (this != &other) {
+            mapped = std::move(other.mapped);
+            span = other.span;
+            length = other.length;
+            packed = other.packed;
+            other.span = nullptr;
+            other.length = 0;
+            other.packed = false;
+        }
+        return *this;
+    }
+
+    bool open(const std::string &path) {
+        close();
+        AssetFileSystem &fileSystem = AssetFileSystem::Instance();
+        if (const ResourcePack::Entry *entry = fileSystem.findPacked(path)) {
+            span = entry->data;
+            length = entry->size;
+            packed = true;
+            fileSystem.stats.packOpens++;
+            fileSystem.stats.packBytes += length;
+            return true;
+        }
+        if (!mapped.open(path))
+            return false;
+        span = mapped.data();
+        length = mapped.size();
+        fileSystem.stats.diskOpens++;
+        fileSystem.stats.diskBytes += length;
+        return true;
+    }
+
+    void close() {
+        mapped.close();
+        span = nullptr;
+        length = 0;
+        packed = false;
+    }
+
+    bool isOpen() const { return span != nullptr; }
+
+    const unsigned char *data() const { return span; }
+
+    size_t size() const { return length; }
+
+    bool fromPack() const { return packed; }
+
+    // a copy of the contents, for the few consumers that need an owned string; counted as copied bytes
+    std::string text() const {
+        if (!span)
+            return std::string();
+        AssetFileSystem::Instance().CountCopy(length);
+        return std::string((const char *) span, length);
+    }
+
+private:
+    MappedFile mapped;
+    const unsigned char *span = nullptr;
+    size_t length = 0;
+    bool packed = false;
+};
+
+#endif //PROJECT_BASE_ASSETFILESYSTEM_H
@@ -0,0 +1,201 @@
+#ifndef PROJECT_BASE_BLOCKCOMPRESSION_H
+#define PROJECT_BASE_BLOCKCOMPRESSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// CPU encoders for the GPU block formats used by baked textures. Every 4x4 pixel block becomes
+//   BC1: 8 bytes, two RGB565 endpoints and a 2-bit index per pixel into the 4 colors between them
+//   BC4: 8 bytes, two 8-bit endpoints and a 3-bit index per pixel into the 8 values between them
+//   BC3: 16 bytes, a BC4 style alpha block followed by a BC1 color block
+// Input blocks are 16 RGBA pixels in row order, edge blocks of images that aren't a multiple of 4 repeat their
+// last row and column. The encoders favour being simple and predictable over the last dB: endpoints come from
+// the principal axis of the block's colors and are refined once by least squares.
+
+namespace BlockCompression {
+
+inline uint16_t packRgb565(const float color[3]) {
+    int r = std::min(31, std::max(0, (int) std::lround(color[0] * 31.0f / 255.0f)));
+    int g = std::min(63, std::max(0, (int) std::lround(color[1] * 63.0f / 255.0f)));
+    int b = std::min(31, std::max(0, (int) std::lround(color[2] * 31.0f / 255.0f)));
+    return (uint16_t) (r << 11 | g << 5 | b);
+}
+
+inline void unpackRgb565(uint16_t packed, int color[3]) {
+    int r = packed >> 11 & 31, g = packed >> 5 & 63, b = packed & 31;
+    color[0] = r << 3 | r >> 2;
+    color[1] = g << 2 | g >> 4;
+    color[2] = b << 3 | b >> 2;
+}
+
+// nearest of the 4 palette colors for every pixel, returns the summed squared error
+inline int bc1Indices(const uint8_t *rgba, uint16_t endpoint0, uint16_t endpoint1, uint32_t &indices) {
+    int palette[4][3];
+    unpackRgb565(endpoint0, palette[0]);
+    unpackRgb565(endpoint1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    int error = 0;
+    indices = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0, bestDistance = INT32_MAX;
+        for (int p = 0; p < 4; p++) {
+            int dr = rgba[i * 4] - palette[p][0], dg = rgba[i * 4 + 1] - palette[p][1], db = rgba[i * 4 + 2] - palette[p][2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance) {
+                best = p;
+                bestDistance = distance;
+            }
+        }
+        indices |= (uint32_t) best << (2 * i);
+        error += bestDistance;
+    }
+    return error;
+}
+
+// endpoints that minimize the squared error for fixed indices, the palette weights are 1, 0, 2/3 and 1/3
+inline bool bc1LeastSquares(const uint8_t *rgba, uint32_t indices, float endpoint0[3], float endpoint1[3]) {
+    static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float a = weights[indices >> (2 * i) & 3], b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < 3; c++) {
+            ax[c] += a * rgba[i * 4 + c];
+            bx[c] += b * rgba[i * 4 + c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::fabs(determinant) < 1e-6f)
+        return false;
+    for (int c = 0; c < 3; c++) {
+        endpoint0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+        endpoint1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+    }
+    return true;
+}
+
+// writes the endpoints so the block decodes in 4 color mode (endpoint0 > endpoint1)
+inline void writeBc1(uint16_t endpoint0, uint16_t endpoint1, uint32_t indices, uint8_t *out) {
+    if (endpoint0 < endpoint1) {
+        std::swap(endpoint0, endpoint1);
+        // 0 <-> 1 and 2 <-> 3
+        indices ^= 0x55555555u;
+    } else if (endpoint0 == endpoint1) {
+        indices = 0;
+    }
+    out[0] = (uint8_t) endpoint0;
+    out[1] = (uint8_t) (endpoint0 >> 8);
+    out[2] = (uint8_t) endpoint1;
+    out[3] = (uint8_t) (endpoint1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (uint8_t) (indices >> (8 * i));
+}
+
+inline void EncodeBC1(const uint8_t *rgba, uint8_t *out) {
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += rgba[i * 4 + c] / 16.0f;
+    float covariance[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {rgba[i * 4] - mean[0], rgba[i * 4 + 1] - mean[1], rgba[i * 4 + 2] - mean[2]};
+        covariance[0] += d[0] * d[0];
+        covariance[1] += d[0] * d[1];
+        covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1];
+        covariance[4] += d[1] * d[2];
+        covariance[5] += d[2] * d[2];
+    }
+    // principal axis by power iteration
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {
+                covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+        };
+        float length = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+    float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float low = 0.0f, high = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = ((rgba[i * 4] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1] +
+                   (rgba[i * 4 + 2] - mean[2]) * axis[2]) / axisLength;
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+    float endpoint0[3], endpoint1[3];
+    for (int c = 0; c < 3; c++) {
+        endpoint0[c] = mean[c] + axis[c] * high;
+        endpoint1[c] = mean[c] + axis[c] * low;
+    }
+
+    uint16_t packed0 = packRgb565(endpoint0), packed1 = packRgb565(endpoint1);
+    uint32_t indices;
+    int error = bc1Indices(rgba, packed0, packed1, indices);
+    if (error > 0 && packed0 != packed1 && bc1LeastSquares(rgba, indices, endpoint0, endpoint1)) {
+        uint16_t refined0 = packRgb565(endpoint0), refined1 = packRgb565(endpoint1);
+        uint32_t refinedIndices;
+        int refinedError = bc1Indices(rgba, refined0, refined1, refinedIndices);
+        if (refinedError < error) {
+            packed0 = refined0;
+            packed1 = refined1;
+            indices = refinedIndices;
+        }
+    }
+    writeBc1(packed0, packed1, indices, out);
+}
+
+// one 8-bit channel of the block (0 = red, 3 = alpha) in the 8 value mode
+inline void EncodeBC4(const uint8_t *rgba, int channel, uint8_t *out) {
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++) {
+        low = std::min(low, (int) rgba[i * 4 + channel]);
+        high = std::max(high, (int) rgba[i * 4 + channel]);
+    }
+    out[0] = (uint8_t) high;
+    out[1] = (uint8_t) low;
+    uint64_t indices = 0;
+    if (high > low) {
+        // palette codes: 0 = high, 1 = low, 2..7 step from high to low
+        static const int codeForStep[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+        for (int i = 0; i < 16; i++) {
+            int value = rgba[i * 4 + channel];
+            int step = (int) std::lround((high - value) * 7.0f / (high - low));
+            indices |= (uint64_t) codeForStep[step] << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (uint8_t) (indices >> (8 * i));
+}
+
+inline void EncodeBC3(const uint8_t *rgba, uint8_t *out) {
+    EncodeBC4(rgba, 3, out);
+    EncodeBC1(rgba, out + 8);
+}
+
+// gathers the 4x4 block at (blockX, blockY) of an RGBA image, clamping at the right and bottom edges
+inline void GatherBlock(const uint8_t *rgba, int width, int height, int blockX, int blockY, uint8_t block[64]) {
+    for (int y = 0; y < 4; y++) {
+        int sourceY = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++) {
+            int sourceX = std::min(blockX * 4 + x, width - 1);
+            memcpy(block + (y * 4 + x) * 4, rgba + ((size_t) sourceY * width + sourceX) * 4, 4);
+        }
+    }
+}
+
+}
+
+#endif //PROJECT_BASE_BLOCKCOMPRESSION_H
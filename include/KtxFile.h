@@ -0,0 +1,281 @@
+#ifndef PROJECT_BASE_KTXFILE_H
+#define PROJECT_BASE_KTXFILE_H
+
+#include <glad/glad.h>
+#include <AssetFileSystem.h>
+#include <common.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/stat.h>
+
+// glad is generated without EXT_texture_compression_s3tc, the enums are fixed by the extension spec
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// Baked textures: KTX 1.1 files holding the block compressed mip chain of a source image, written by the
+// project_base_bake tool and read by TextureLoader. A baked file is only used while the source it was made from is
+// unchanged, the source size and modification time are stored in the key/value data. A cubemap is baked from its
+// six face images into a single file with six faces per level.
+//
+// Layout (all little endian): 12 byte identifier, 13 uint32 header fields, key/value pairs, then per mip level
+// a uint32 image size followed by the blocks of every face. Block data is always a multiple of 4 bytes, so no
+// padding is needed between levels or faces.
+class KtxFile {
+public:
+    static const size_t IDENTIFIER_SIZE = 12;
+    // bumped whenever baking changes, older bakes count as stale
+    static const int BAKE_VERSION = 2;
+
+    struct Level {
+        uint32_t width, height;
+        uint64_t offset; // of the first face
+        uint32_t size;   // of one face
+    };
+
+    static std::string &Directory() {
+        static std::string directory = "resources/cache/textures";
+        return directory;
+    }
+
+    static bool &Enabled() {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    // where the baked version of a source image lives; flipped images are baked separately
+    static std::string BakedPath(const std::string &sourcePath, bool flip) {
+        return BakedPath(std::vector<std::string>{sourcePath}, flip);
+    }
+
+    // the same for a cubemap, named after all six faces in order
+    static std::string BakedPath(const std::vector<std::string> &sourcePaths, bool flip) {
+        std::string key;
+        for (const std::string &sourcePath : sourcePaths) {
+            char resolved[PATH_MAX];
+            key += key.empty() ? "" : "\n";
+            key += realpath(sourcePath.c_str(), resolved) ? resolved : sourcePath;
+        }
+        char name[48];
+        snprintf(name, sizeof(name), "%016llx%s%s.ktx", (unsigned long long) fnv1a64(key), sourcePaths.size() == 6 ? "_cube" : "",
+                 flip ? "_flipped" : "");
+        return Directory() + '/' + name;
+    }
+
+    // size and modification time of a source file, as stored in the key/value data
+    static std::string SourceStamp(const std::string &sourcePath) {
+        struct stat info;
+        if (stat(sourcePath.c_str(), &info) != 0)
+            return std::string();
+        return std::to_string((long long) info.st_size) + ':' + std::to_string((long long) info.st_mtime);
+    }
+
+    // the stamps of all faces separated by ';', empty when one of them is missing
+    static std::string SourceStamp(const std::vector<std::string> &sourcePaths) {
+        std::string stamps;
+        for (const std::string &sourcePath : sourcePaths) {
+            std::string stamp = SourceStamp(sourcePath);
+            if (stamp.empty())
+                return std::string();
+            stamps += stamps.empty() ? stamp : ';' + stamp;
+        }
+        return stamps;
+    }
+
+    // identifies source images by their contents: the hash of every file's bytes chained with the flip flag, 0 when
+    // one of them could not be read. Baked files carry it in RGSourceHash
+    static uint64_t SourceHash(const std::vector<uint64_t> &fileHashes, bool flip) {
+        uint64_t hash = fnv1a64(&flip, sizeof(flip));
+        for (uint64_t fileHash : fileHashes) {
+            if (fileHash == 0)
+                return 0;
+            hash = fnv1a64(&fileHash, sizeof(fileHash), hash);
+        }
+        return hash;
+    }
+
+    static uint64_t SourceHash(const std::vector<std::string> &sourcePaths, bool flip) {
+        std::vector<uint64_t> fileHashes;
+        for (const std::string &sourcePath : sourcePaths) {
+            AssetFile file(sourcePath);
+            fileHashes.push_back(file.isOpen() ? fnv1a64(file.data(), file.size()) : 0);
+        }
+        return SourceHash(fileHashes, flip);
+    }
+
+    static size_t BlockBytes(uint32_t internalFormat) {
+        return internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : 8;
+    }
+
+    static size_t LevelBytes(uint32_t internalFormat, uint32_t width, uint32_t height) {
+        return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(internalFormat);
+    }
+
+    bool Open(const std::string &path) {
+        levels.clear();
+        values.clear();
+        if (!file.open(path) || file.size() < IDENTIFIER_SIZE + 13 * 4)
+            return false;
+        const unsigned char *data = file.data();
+        if (memcmp(data, identifier(), IDENTIFIER_SIZE) != 0)
+            return false;
+        uint32_t header[13];
+        memcpy(header, data + IDENTIFIER_SIZE, sizeof(header));
+        if (header[0] != 0x04030201)
+            return false;
+        internalFormat = header[4];
+        baseFormat = header[5];
+        width = header[6];
+        height = std::max(header[7], 1u);
+        faces = header[10];
+        uint32_t levelCount = std::max(header[11], 1u);
+        if (header[8] != 0 || header[9] != 0 || (faces != 1 && faces != 6) || width == 0 ||
+            (internalFormat != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && internalFormat != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT &&
+             internalFormat != GL_COMPRESSED_RED_RGTC1))
+            return false;
+
+        uint64_t offset = IDENTIFIER_SIZE + sizeof(header);
+        uint64_t valuesEnd = offset + header[12];
+        if (valuesEnd > file.size())
+            return false;
+        while (offset + 4 <= valuesEnd) {
+            uint32_t length;
+            memcpy(&length, data + offset, 4);
+            if (offset + 4 + length > valuesEnd)
+                return false;
+            const char *pair = (const char *) data + offset + 4;
+            size_t keyLength = strnlen(pair, length);
+            std::string key(pair, keyLength);
+            std::string value = keyLength < length ? std::string(pair + keyLength + 1, strnlen(pair + keyLength + 1, length - keyLength - 1)) : std::string();
+            values.push_back(std::make_pair(key, value));
+            offset += 4 + ((length + 3) & ~3u);
+        }
+
+        offset = valuesEnd;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            Level entry;
+            entry.width = std::max(width >> level, 1u);
+            entry.height = std::max(height >> level, 1u);
+            if (offset + 4 > file.size())
+                return false;
+            memcpy(&entry.size, data + offset, 4);
+            entry.offset = offset + 4;
+            if (entry.size != LevelBytes(internalFormat, entry.width, entry.height) ||
+                entry.offset + (uint64_t) entry.size * faces > file.size())
+                return false;
+            levels.push_back(entry);
+            offset = entry.offset + (uint64_t) entry.size * faces;
+        }
+        return true;
+    }
+
+    // the baked file of a source if it exists and was made from the source as it is now
+    bool OpenBaked(const std::string &sourcePath, bool flip) {
+        return OpenBaked(std::vector<std::string>{sourcePath}, flip);
+    }
+
+    // one source is a 2D texture, six are the faces of a cubemap
+    bool OpenBaked(const std::vector<std::string> &sourcePaths, bool flip) {
+        if (!Enabled() || !Open(BakedPath(sourcePaths, flip)) || faces != sourcePaths.size())
+            return false;
+        std::string stamp = SourceStamp(sourcePaths);
+        return !stamp.empty() && Value("RGSourceStamp") == stamp && Value("RGBakeVersion") == std::to_string(BAKE_VERSION);
+    }
+
+    std::string Value(const std::string &key) const {
+        for (const auto &pair : values)
+            if (pair.first == key)
+                return pair.second;
+        return std::string();
+    }
+
+    // the SourceHash of the images the file was baked from, 0 for bakes made before it was stored
+    uint64_t StoredSourceHash() const {
+        return strtoull(Value("RGSourceHash").c_str(), nullptr, 16);
+    }
+
+    const unsigned char *Data(uint32_t level, uint32_t face = 0) const {
+        return file.data() + levels[level].offset + (uint64_t) levels[level].size * face;
+    }
+
+    size_t TotalBytes() const {
+        size_t total = 0;
+        for (const Level &level : levels)
+            total += (size_t) level.size * faces;
+        return total;
+    }
+
+    // faceLevels[face][level] holds the blocks of each level, keyValues are written in order
+    static bool Write(const std::string &path, uint32_t internalFormat, uint32_t baseFormat, uint32_t width, uint32_t height,
+                      const std::vector<std::vector<std::vector<unsigned char>>> &faceLevels,
+                      const std::vector<std::pair<std::string, std::string>> &keyValues) {
+        std::vector<unsigned char> keyValueData;
+        for (const auto &pair : keyValues) {
+            uint32_t length = (uint32_t) (pair.first.size() + 1 + pair.second.size() + 1);
+            appendBytes(keyValueData, &length, 4);
+            appendBytes(keyValueData, pair.first.c_str(), pair.first.size() + 1);
+            appendBytes(keyValueData, pair.second.c_str(), pair.second.size() + 1);
+            keyValueData.resize((keyValueData.size() + 3) & ~(size_t) 3, 0);
+        }
+
+        uint32_t levelCount = faceLevels.empty() ? 0 : (uint32_t) faceLevels[0].size();
+        uint32_t header[13] = {0x04030201, 0, 1, 0, internalFormat, baseFormat, width, height, 0, 0,
+                               (uint32_t) faceLevels.size(), levelCount, (uint32_t) keyValueData.size()};
+
+        size_t slash = path.find_last_of('/');
+        if (slash != std::string::npos && !makeDirectories(path.substr(0, slash)))
+            return false;
+        std::string temporary = path + ".tmp";
+        FILE *out = fopen(temporary.c_str(), "wb");
+        if (!out)
+            return false;
+        bool ok = fwrite(identifier(), IDENTIFIER_SIZE, 1, out) == 1 && fwrite(header, sizeof(header), 1, out) == 1 &&
+                  (keyValueData.empty() || fwrite(keyValueData.data(), keyValueData.size(), 1, out) == 1);
+        for (uint32_t level = 0; ok && level < levelCount; level++) {
+            uint32_t size = (uint32_t) faceLevels[0][level].size();
+            ok = fwrite(&size, 4, 1, out) == 1;
+            for (size_t face = 0; ok && face < faceLevels.size(); face++)
+                ok = faceLevels[face][level].size() == size && fwrite(faceLevels[face][level].data(), size, 1, out) == 1;
+        }
+        ok = fclose(out) == 0 && ok;
+        // written under a temporary name first, so a reader never sees a half written file
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t internalFormat = 0;
+    uint32_t baseFormat = 0;
+    uint32_t width = 0, height = 0, faces = 0;
+    std::vector<Level> levels;
+
+private:
+    static const unsigned char *identifier() {
+        static const unsigned char bytes[IDENTIFIER_SIZE] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+        return bytes;
+    }
+
+    AssetFile file;
+    std::vector<std::pair<std::string, std::string>> values;
+
+    static void appendBytes(std::vector<unsigned char> &bytes, const void *data, size_t size) {
+        const unsigned char *begin = static_cast<const unsigned char *>(data);
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+};
+
+#endif //PROJECT_BASE_KTXFILE_H
@@ -0,0 +1,438 @@
+#ifndef PROJECT_BASE_LIGHTCLUSTERS_H
+#define PROJECT_BASE_LIGHTCLUSTERS_H
+
+#include <learnopengl/shader.h>
+#include <ThreadPool.h>
+#include <Timer.h>
+#include <UniformBlocks.h>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Clustered forward lighting: the view frustum is cut into screen tiles and exponential depth slices, and every
+// frame each light is listed in the clusters its range reaches. A fragment of the CLUSTERED advanced_lighting
+// variant only walks the list of its own cluster, so a light costs something only where it can be seen.
+//
+//   1. lights that reach everything (directional, or never falling off) go first in the light data, every fragment
+//      lights with them, the rest are moved to view space with the distance at which they fade out
+//   2. the depth slices are assigned on the thread pool; a slice keeps the lights whose range overlaps its depths
+//      and tests them four at a time (SSE2) against the box of each of its clusters, spot lights also by their cone
+//   3. the lists of the slices are joined into one index list, with an offset and a count per cluster
+// Light data, cluster grid and index list are texture buffers, GL 3.3 has no storage buffers.
+const unsigned int CLUSTER_TILES_X = 16;
+const unsigned int CLUSTER_TILES_Y = 9;
+const unsigned int CLUSTER_SLICES = 24;
+// texture units of the three buffers, above the ones materials use
+const unsigned int LIGHT_DATA_UNIT = 8;
+const unsigned int CLUSTER_GRID_UNIT = 9;
+const unsigned int CLUSTER_LIGHTS_UNIT = 10;
+// a light ends where it adds less than this to its brightest channel
+const float LIGHT_RANGE_THRESHOLD = 1.0f / 256.0f;
+// light indices are 16 bit
+const size_t MAX_CLUSTERED_LIGHTS = 65535;
+// the smallest buffer allocated, a texture buffer of no texels is allowed to fail
+const size_t CLUSTER_BUFFER_MIN_BYTES = 16;
+
+// the distance at which a light's attenuation brings it under LIGHT_RANGE_THRESHOLD; negative when it never does
+float LightRange(const LightBlock &light) {
+    if (light.type == LIGHT_DIRECTIONAL)
+        return -1.0f;
+    glm::vec3 brightest = glm::max(light.ambient, glm::max(light.diffuse, light.specular));
+    // solve constant + linear * d + quadratic * d^2 = brightest / threshold
+    float c = light.constant - std::max(brightest.x, std::max(brightest.y, brightest.z)) / LIGHT_RANGE_THRESHOLD;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic > 0.0f)
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) /
+               (2.0f * light.quadratic);
+    if (light.linear > 0.0f)
+        return -c / light.linear;
+    return -1.0f;
+}
+
+// Bit i is set when the sphere of light i, of the four at x, y, z with squared radius radiusSq, touches the box.
+// Padding lights have a negative squared radius and never touch anything.
+unsigned int spheresTouchingBox(const float *x, const float *y, const float *z, const float *radiusSq,
+                                const glm::vec3 &boxMin, const glm::vec3 &boxMax) {
+#if defined(__SSE2__)
+    __m128 zero = _mm_setzero_ps();
+    __m128 cx = _mm_loadu_ps(x), cy = _mm_loadu_ps(y), cz = _mm_loadu_ps(z);
+    // distance from the box along each axis, zero inside it
+    __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(boxMin.x), cx), _mm_sub_ps(cx, _mm_set1_ps(boxMax.x))), zero);
+    __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(boxMin.y), cy), _mm_sub_ps(cy, _mm_set1_ps(boxMax.y))), zero);
+    __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(boxMin.z), cz), _mm_sub_ps(cz, _mm_set1_ps(boxMax.z))), zero);
+    __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    return (unsigned int) _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_loadu_ps(radiusSq)));
+#else
+    unsigned int mask = 0;
+    for (int i = 0; i < 4; i++) {
+        float dx = std::max(std::max(boxMin.x - x[i], x[i] - boxMax.x), 0.0f);
+        float dy = std::max(std::max(boxMin.y - y[i], y[i] - boxMax.y), 0.0f);
+        float dz = std::max(std::max(boxMin.z - z[i], z[i] - boxMax.z), 0.0f);
+        if (dx * dx + dy * dy + dz * dz <= radiusSq[i])
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+class LightClusters {
+public:
+    struct Stats {
+        size_t lights = 0;           // in the light data
+        size_t globalLights = 0;
+        size_t indices = 0;          // cluster list entries, over all clusters
+        size_t maxClusterLights = 0; // the longest list
+        double milliseconds = 0.0;   // CPU time of the last Build
+    };
+
+    explicit LightClusters(unsigned int tilesX = CLUSTER_TILES_X, unsigned int tilesY = CLUSTER_TILES_Y,
+                           unsigned int slices = CLUSTER_SLICES)
+            : tilesX(tilesX), tilesY(tilesY), slices(slices), sliceWork(slices) {
+    }
+
+    // for every program using the Clusters block and the cluster buffers
+    static void Configure(Shader &shader) {
+        shader.BindUniformBlock("Clusters", CLUSTERS_BLOCK_BINDING);
+        shader.use();
+        shader.setInt("lightData", LIGHT_DATA_UNIT);
+        shader.setInt("clusterGrid", CLUSTER_GRID_UNIT);
+        shader.setInt("clusterLights", CLUSTER_LIGHTS_UNIT);
+    }
+
+    // Assigns the lights to the clusters of a view drawn with projection, which has to be a perspective projection
+    // with the given near and far planes, into a width x height viewport. Lights past MAX_CLUSTERED_LIGHTS are
+    // dropped.
+    void Build(const std::vector<LightBlock> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+               float near, float far, int width, int height) {
+        Timer timer;
+        // a minimized window has no pixels, any tiling will do
+        updateGeometry(projection, near, far, std::max(width, 1), std::max(height, 1));
+
+        // global lights first, then the local ones in the order they came in
+        lightData.clear();
+        size_t count = std::min(lights.size(), MAX_CLUSTERED_LIGHTS);
+        ranges.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            ranges[i] = LightRange(lights[i]);
+            if (ranges[i] < 0.0f)
+                lightData.push_back(lights[i]);
+        }
+        block.globalLights = (uint32_t) lightData.size();
+        locals.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (ranges[i] < 0.0f)
+                continue;
+            const LightBlock &light = lights[i];
+            LocalLight local;
+            local.index = (uint16_t) lightData.size();
+            local.center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            local.radius = ranges[i];
+            local.spot = light.type == LIGHT_SPOT;
+            if (local.spot) {
+                local.direction = glm::normalize(glm::mat3(view) * light.direction);
+                local.cosOuter = light.outerCutOff;
+                local.sinOuter = std::sqrt(std::max(0.0f, 1.0f - light.outerCutOff * light.outerCutOff));
+            }
+            locals.push_back(local);
+            lightData.push_back(light);
+        }
+
+        ThreadPool::Shared().ParallelFor(slices, [this](size_t slice) { assignSlice((unsigned int) slice); });
+
+        unsigned int tiles = tilesX * tilesY;
+        grid.resize((size_t) tiles * slices * 2);
+        indices.clear();
+        stats.maxClusterLights = 0;
+        for (unsigned int slice = 0; slice < slices; slice++) {
+            const SliceWork &work = sliceWork[slice];
+            uint32_t offset = (uint32_t) indices.size();
+            for (unsigned int tile = 0; tile < tiles; tile++) {
+                size_t cluster = (size_t) slice * tiles + tile;
+                grid[cluster * 2] = offset;
+                grid[cluster * 2 + 1] = work.counts[tile];
+                offset += work.counts[tile];
+                stats.maxClusterLights = std::max(stats.maxClusterLights, (size_t) work.counts[tile]);
+            }
+            indices.insert(indices.end(), work.indices.begin(), work.indices.end());
+        }
+
+        stats.lights = lightData.size();
+        stats.globalLights = block.globalLights;
+        stats.indices = indices.size();
+        stats.milliseconds = timer.Milliseconds();
+    }
+
+    // with the GL context current
+    void Create() {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+        for (int i = 0; i < 3; i++) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, CLUSTER_BUFFER_MIN_BYTES, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        blockBuffer.Create(CLUSTERS_BLOCK_BINDING);
+        uploadedLights.clear();
+    }
+
+    void Destroy() {
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+        blockBuffer.Destroy();
+    }
+
+    // uploads the result of the last Build and binds the buffers to their texture units; the light data only when
+    // it changed
+    void Upload() {
+        size_t lightBytes = lightData.size() * sizeof(LightBlock);
+        if (uploadedLights.size() != lightData.size() || memcmp(uploadedLights.data(), lightData.data(), lightBytes) != 0) {
+            upload(buffers[0], lightData.data(), lightBytes);
+            uploadedLights = lightData;
+        }
+        upload(buffers[1], grid.data(), grid.size() * sizeof(uint32_t));
+        upload(buffers[2], indices.data(), indices.size() * sizeof(uint16_t));
+        blockBuffer.Update(block);
+
+        const unsigned int units[3] = {LIGHT_DATA_UNIT, CLUSTER_GRID_UNIT, CLUSTER_LIGHTS_UNIT};
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + units[i]);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    const Stats &GetStats() const {
+        return stats;
+    }
+
+    // the last Build: per cluster (tile x + tiles across * (tile y + tiles down * slice)) an offset into Indices()
+    // and a count
+    const std::vector<uint32_t> &Grid() const {
+        return grid;
+    }
+
+    const std::vector<uint16_t> &Indices() const {
+        return indices;
+    }
+
+    const std::vector<LightBlock> &LightData() const {
+        return lightData;
+    }
+
+private:
+    struct LocalLight {
+        glm::vec3 center; // in view space
+        float radius;
+        uint16_t index;   // into the light data
+        bool spot;
+        glm::vec3 direction;
+        float cosOuter, sinOuter;
+    };
+
+    // view space spheres of lights, a row per member so four lights load at once; padded to a multiple of four
+    struct LightRows {
+        std::vector<float> x, y, z, radiusSq;
+        std::vector<uint32_t> light; // into locals
+
+        void Clear() {
+            x.clear();
+            y.clear();
+            z.clear();
+            radiusSq.clear();
+            light.clear();
+        }
+
+        void Add(const LocalLight &local, uint32_t index) {
+            x.push_back(local.center.x);
+            y.push_back(local.center.y);
+            z.push_back(local.center.z);
+            radiusSq.push_back(local.radius * local.radius);
+            light.push_back(index);
+        }
+
+        void Pad() {
+            while (x.size() % 4 != 0) {
+                x.push_back(0.0f);
+                y.push_back(0.0f);
+                z.push_back(0.0f);
+                radiusSq.push_back(-1.0f);
+            }
+        }
+    };
+
+    // the lights of one slice, of the row of tiles being assigned, and the slice's part of the result
+    struct SliceWork {
+        LightRows candidates, row;
+        std::vector<uint32_t> counts;
+        std::vector<uint16_t> indices;
+    };
+
+    unsigned int tilesX, tilesY, slices;
+    std::vector<SliceWork> sliceWork;
+    std::vector<LocalLight> locals;
+    std::vector<float> ranges;
+    std::vector<LightBlock> lightData, uploadedLights;
+    std::vector<uint32_t> grid;
+    std::vector<uint16_t> indices;
+    Stats stats;
+
+    // the view space boxes of the clusters, for the last projection and viewport
+    glm::mat4 geometryProjection = glm::mat4(0.0f);
+    float geometryNear = 0.0f, geometryFar = 0.0f;
+    int geometryWidth = 0, geometryHeight = 0;
+    std::vector<float> sliceDepths;
+    std::vector<glm::vec3> boxMin, boxMax;
+
+    ClustersBlock block = {};
+    UniformBuffer<ClustersBlock> blockBuffer;
+    unsigned int buffers[3] = {};
+    unsigned int textures[3] = {};
+
+    void updateGeometry(const glm::mat4 &projection, float near, float far, int width, int height) {
+        if (projection == geometryProjection && near == geometryNear && far == geometryFar && width == geometryWidth &&
+            height == geometryHeight)
+            return;
+        geometryProjection = projection;
+        geometryNear = near;
+        geometryFar = far;
+        geometryWidth = width;
+        geometryHeight = height;
+
+        float tileWidth = (float) ((width + tilesX - 1) / tilesX), tileHeight = (float) ((height + tilesY - 1) / tilesY);
+        float logRatio = std::log(far / near);
+        block.size[0] = tilesX;
+        block.size[1] = tilesY;
+        block.size[2] = slices;
+        block.sliceScale = slices / logRatio;
+        block.sliceBias = -(float) slices * std::log(near) / logRatio;
+        block.tileSize[0] = tileWidth;
+        block.tileSize[1] = tileHeight;
+
+        sliceDepths.resize(slices + 1);
+        for (unsigned int slice = 0; slice <= slices; slice++)
+            sliceDepths[slice] = near * std::pow(far / near, (float) slice / slices);
+
+        // the corners of each tile as rays through view depth 1
+        glm::mat4 inverse = glm::inverse(projection);
+        std::vector<glm::vec2> corners((size_t) (tilesX + 1) * (tilesY + 1));
+        for (unsigned int y = 0; y <= tilesY; y++)
+            for (unsigned int x = 0; x <= tilesX; x++) {
+                glm::vec4 p = inverse * glm::vec4(2.0f * x * tileWidth / width - 1.0f, 2.0f * y * tileHeight / height - 1.0f,
+                                                  -1.0f, 1.0f);
+                corners[(size_t) y * (tilesX + 1) + x] = glm::vec2(p) / -p.z;
+            }
+
+        boxMin.resize((size_t) tilesX * tilesY * slices);
+        boxMax.resize(boxMin.size());
+        for (unsigned int slice = 0; slice < slices; slice++)
+            for (unsigned int y = 0; y < tilesY; y++)
+                for (unsigned int x = 0; x < tilesX; x++) {
+                    glm::vec3 low(INFINITY), high(-INFINITY);
+                    for (unsigned int corner = 0; corner < 4; corner++) {
+                        glm::vec2 ray = corners[(size_t) (y + corner / 2) * (tilesX + 1) + x + corner % 2];
+                        for (float depth : {sliceDepths[slice], sliceDepths[slice + 1]}) {
+                            glm::vec3 p(ray * depth, -depth);
+                            low = glm::min(low, p);
+                            high = glm::max(high, p);
+                        }
+                    }
+                    size_t cluster = ((size_t) slice * tilesY + y) * tilesX + x;
+                    boxMin[cluster] = low;
+                    boxMax[cluster] = high;
+                }
+    }
+
+    // a slice's candidates are narrowed down per row of tiles first, then tested against each cluster of the row
+    void assignSlice(unsigned int slice) {
+        SliceWork &work = sliceWork[slice];
+        work.candidates.Clear();
+        work.indices.clear();
+        work.counts.assign((size_t) tilesX * tilesY, 0);
+
+        float nearDepth = sliceDepths[slice], farDepth = sliceDepths[slice + 1];
+        for (size_t i = 0; i < locals.size(); i++) {
+            float depth = -locals[i].center.z;
+            if (depth + locals[i].radius >= nearDepth && depth - locals[i].radius <= farDepth)
+                work.candidates.Add(locals[i], (uint32_t) i);
+        }
+        work.candidates.Pad();
+
+        for (unsigned int y = 0; y < tilesY; y++) {
+            size_t rowStart = ((size_t) slice * tilesY + y) * tilesX;
+            glm::vec3 rowMin = boxMin[rowStart], rowMax = boxMax[rowStart];
+            for (unsigned int x = 1; x < tilesX; x++) {
+                rowMin = glm::min(rowMin, boxMin[rowStart + x]);
+                rowMax = glm::max(rowMax, boxMax[rowStart + x]);
+            }
+            work.row.Clear();
+            forEachTouching(work.candidates, rowMin, rowMax, [&](uint32_t light) { work.row.Add(locals[light], light); });
+            work.row.Pad();
+
+            for (unsigned int x = 0; x < tilesX; x++) {
+                const glm::vec3 &low = boxMin[rowStart + x], &high = boxMax[rowStart + x];
+                uint32_t &count = work.counts[(size_t) y * tilesX + x];
+                forEachTouching(work.row, low, high, [&](uint32_t light) {
+                    work.indices.push_back(locals[light].index);
+                    count++;
+                });
+            }
+        }
+    }
+
+    // calls touching(light) for the lights of rows that reach the box, in the order of the rows
+    template<typename F>
+    void forEachTouching(const LightRows &rows, const glm::vec3 &low, const glm::vec3 &high, F touching) const {
+        for (size_t first = 0; first < rows.x.size(); first += 4) {
+            unsigned int mask = spheresTouchingBox(&rows.x[first], &rows.y[first], &rows.z[first], &rows.radiusSq[first],
+                                                   low, high);
+            for (; mask; mask &= mask - 1) {
+                uint32_t light = rows.light[first + lowestBit(mask)];
+                if (!locals[light].spot || coneTouchesBox(locals[light], low, high))
+                    touching(light);
+            }
+        }
+    }
+
+    static unsigned int lowestBit(unsigned int mask) {
+        unsigned int bit = 0;
+        while (!(mask & (1u << bit)))
+            bit++;
+        return bit;
+    }
+
+    // the cone against the sphere around the box, after "Cull that cone!" (Wronski)
+    static bool coneTouchesBox(const LocalLight &light, const glm::vec3 &low, const glm::vec3 &high) {
+        glm::vec3 center = (low + high) * 0.5f;
+        float radius = glm::length(high - center);
+        glm::vec3 toCenter = center - light.center;
+        float lengthSq = glm::dot(toCenter, toCenter);
+        float along = glm::dot(toCenter, light.direction);
+        float closest = light.cosOuter * std::sqrt(std::max(0.0f, lengthSq - along * along)) - along * light.sinOuter;
+        return closest <= radius && along <= radius + light.radius && along >= -radius;
+    }
+
+    static void upload(unsigned int buffer, const void *data, size_t bytes) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        // orphaned, a draw still reading last frame's lists doesn't hold up the new ones
+        glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, CLUSTER_BUFFER_MIN_BYTES), nullptr, GL_STREAM_DRAW);
+        if (bytes > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+
+#endif //PROJECT_BASE_LIGHTCLUSTERS_H
@@ -0,0 +1,94 @@
+#ifndef PROJECT_BASE_MAPPEDFILE_H
+#define PROJECT_BASE_MAPPEDFILE_H
+
+#include <atomic>
+#include <string>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. The mapping stays valid for the lifetime of the object,
+// so pointers into data() can be handed straight to glBufferData without an intermediate copy.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string &path) {
+        open(path);
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept : mapping(other.mapping), length(other.length) {
+        other.mapping = nullptr;
+        other.length = 0;
+    }
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            mapping = other.mapping;
+            length = other.length;
+            other.mapping = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    // open, fstat, mmap, close and munmap calls made by all mapped files so far
+    static std::atomic<size_t> &SystemCalls() {
+        static std::atomic<size_t> calls(0);
+        return calls;
+    }
+
+    bool open(const std::string &path) {
+        close();
+        SystemCalls()++;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        SystemCalls() += 2; // fstat and the close below
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            SystemCalls()++;
+            void *address = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                mapping = address;
+                length = (size_t) info.st_size;
+            }
+        }
+        // the mapping keeps its own reference to the file, the descriptor is not needed anymore
+        ::close(fd);
+        return mapping != nullptr;
+    }
+
+    void close() {
+        if (mapping) {
+            munmap(mapping, length);
+            SystemCalls()++;
+        }
+        mapping = nullptr;
+        length = 0;
+    }
+
+    bool isOpen() const { return mapping != nullptr; }
+
+    const unsigned char *data() const { return static_cast<const unsigned char *>(mapping); }
+
+    size_t size() const { return length; }
+
+private:
+    void *mapping = nullptr;
+    size_t length = 0;
+};
+
+#endif //PROJECT_BASE_MAPPEDFILE_H
@@ -0,0 +1,120 @@
+#ifndef PROJECT_BASE_PIXELUPLOADRING_H
+#define PROJECT_BASE_PIXELUPLOADRING_H
+
+#include <glad/glad.h>
+#include <Timer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+// Texture uploads staged through a ring of pixel unpack buffers. Upload() copies the pixels into the next buffer
+// of the ring through glMapBufferRange and issues the glTexImage2D/glCompressedTexImage2D with the buffer bound,
+// so the driver reads them on its own time instead of copying client memory before the call returns. A fence
+// after each upload marks when the buffer may be written again; a buffer whose fence hasn't signaled yet is
+// never waited for, the upload goes straight from client memory instead. Buffers grow to the largest upload
+// they staged up to MAX_STAGED_BYTES, anything bigger is uploaded directly as well.
+//
+// Used by one thread with a current context at a time, which also owns the stats. The buffers are created with the
+// first upload and are left to the context at exit.
+class PixelUploadRing {
+public:
+    static const size_t SLOT_COUNT = 4;
+    static const size_t MIN_SLOT_BYTES = 4 * 1024 * 1024;
+    static const size_t MAX_STAGED_BYTES = 16 * 1024 * 1024;
+
+    struct Stats {
+        size_t uploads = 0;
+        size_t stagedUploads = 0; // the rest went from client memory because the ring was busy or they were too big
+        size_t bytes = 0;
+        double milliseconds = 0.0; // time spent in Upload, on the thread that uploads
+
+        double MegabytesPerSecond() const {
+            return milliseconds > 0.0 ? bytes / 1048576.0 / (milliseconds / 1000.0) : 0.0;
+        }
+
+        double MillisecondsPerUpload() const {
+            return uploads > 0 ? milliseconds / uploads : 0.0;
+        }
+    };
+
+    static bool &Enabled() {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    // upload receives the pointer to pass to the GL call: an offset into the bound buffer, or data itself
+    void Upload(const void *data, size_t bytes, const std::function<void(const void *)> &upload) {
+        Timer timer;
+        Slot *slot = Enabled() && bytes <= MAX_STAGED_BYTES ? acquire(bytes) : nullptr;
+        if (slot) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot->buffer);
+            void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (mapped) {
+                memcpy(mapped, data, bytes);
+                if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+                    upload(nullptr);
+                    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                    stats.stagedUploads++;
+                    finish(bytes, timer);
+                    return;
+                }
+            }
+            // the mapping failed or its contents were lost, the slot is still free for the next upload
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        upload(data);
+        finish(bytes, timer);
+    }
+
+    const Stats &GetStats() const {
+        return stats;
+    }
+
+private:
+    struct Slot {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = nullptr;
+    };
+
+    std::vector<Slot> slots;
+    size_t next = 0;
+    Stats stats;
+
+    // the next slot of the ring if the GPU is done reading it, grown to fit bytes
+    Slot *acquire(size_t bytes) {
+        if (slots.empty()) {
+            slots.resize(SLOT_COUNT);
+            for (Slot &slot : slots)
+                glGenBuffers(1, &slot.buffer);
+        }
+        Slot &slot = slots[next];
+        if (slot.fence) {
+            GLenum status = glClientWaitSync(slot.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                return nullptr;
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+        }
+        if (slot.capacity < bytes) {
+            slot.capacity = std::max(bytes, (size_t) MIN_SLOT_BYTES);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, slot.capacity, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        next = (next + 1) % slots.size();
+        return &slot;
+    }
+
+    void finish(size_t bytes, const Timer &timer) {
+        stats.uploads++;
+        stats.bytes += bytes;
+        stats.milliseconds += timer.Milliseconds();
+    }
+};
+
+#endif //PROJECT_BASE_PIXELUPLOADRING_H
@@ -0,0 +1,201 @@
+#ifndef PROJECT_BASE_PROGRAMBINARYCACHE_H
+#define PROJECT_BASE_PROGRAMBINARYCACHE_H
+
+#include <glad/glad.h>
+#include <common.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// glad is generated for plain 3.3 core, the enums of ARB_get_program_binary (core in 4.1) are fixed by the spec
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// Linked shader programs saved with glGetProgramBinary and loaded back with glProgramBinary on the next run, so
+// Shader skips compiling and linking. A binary is only valid for the driver that produced it, the file name is a
+// hash of the program's sources together with the GL vendor, renderer and version strings. A binary the driver
+// refuses (after an update it didn't change its version string for, say) is reported as a miss and gets replaced.
+//
+// The entry points aren't part of glad's 3.3 core profile, LoadEntryPoints() resolves them with the same loader
+// glad used. Without ARB_get_program_binary or any binary format the cache stays disabled and programs are compiled
+// as before.
+class ProgramBinaryCache {
+public:
+    static ProgramBinaryCache &Instance() {
+        static ProgramBinaryCache cache;
+        return cache;
+    }
+
+    static std::string &Directory() {
+        static std::string directory = "resources/cache/shaders";
+        return directory;
+    }
+
+    static bool &Enabled() {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    // after gladLoadGLLoader, with the same loader; false when the driver can't hand out program binaries
+    bool LoadEntryPoints(GLADloadproc loader) {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool available = major > 4 || (major == 4 && minor >= 1);
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; !available && i < extensionCount; i++) {
+            const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, i);
+            available = extension && strcmp(extension, "GL_ARB_get_program_binary") == 0;
+        }
+        if (!available)
+            return false;
+
+        getProgramBinary = (GetProgramBinaryProc) loader("glGetProgramBinary");
+        programBinary = (ProgramBinaryProc) loader("glProgramBinary");
+        programParameteri = (ProgramParameteriProc) loader("glProgramParameteri");
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (!getProgramBinary || !programBinary || !programParameteri || formats == 0)
+            return false;
+
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            const char *value = (const char *) glGetString(name);
+            driver += value ? value : "";
+            driver += '\n';
+        }
+        supported = true;
+        return true;
+    }
+
+    bool Supported() const {
+        return supported && Enabled();
+    }
+
+    // the shader sources of a program in stage order, with the driver they are compiled by
+    uint64_t Key(const std::vector<std::string> &sources) const {
+        uint64_t hash = fnv1a64(driver);
+        for (const std::string &source : sources) {
+            hash = fnv1a64(source, hash);
+            // a separator, so moving text from one stage to the next changes the key
+            hash = fnv1a64("\0", 1, hash);
+        }
+        return hash;
+    }
+
+    std::string Path(uint64_t key) const {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+        return Directory() + '/' + name;
+    }
+
+    // a linked program from the cached binary, 0 when there is none or the driver rejects it. compileMilliseconds
+    // is how long the program took to build when it was saved.
+    unsigned int LoadProgram(uint64_t key, double &compileMilliseconds) const {
+        if (!Supported())
+            return 0;
+        FILE *in = fopen(Path(key).c_str(), "rb");
+        if (!in)
+            return 0;
+        Header header;
+        std::vector<unsigned char> binary;
+        bool ok = fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, "RGPB", 4) == 0 &&
+                  header.version == FILE_VERSION && header.length > 0;
+        if (ok) {
+            binary.resize(header.length);
+            ok = fread(binary.data(), binary.size(), 1, in) == 1;
+        }
+        fclose(in);
+        if (!ok)
+            return 0;
+
+        unsigned int program = glCreateProgram();
+        programBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        compileMilliseconds = header.compileMilliseconds;
+        return program;
+    }
+
+    // before glLinkProgram; lets the driver know the binary will be asked for
+    void PrepareToSave(unsigned int program) const {
+        if (Supported())
+            programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // after a successful link
+    bool Save(uint64_t key, unsigned int program, double compileMilliseconds) const {
+        if (!Supported())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        Header header;
+        memcpy(header.magic, "RGPB", 4);
+        header.version = FILE_VERSION;
+        header.length = (uint32_t) length;
+        header.compileMilliseconds = compileMilliseconds;
+        std::vector<unsigned char> binary(length);
+        GLenum format = 0;
+        getProgramBinary(program, length, nullptr, &format, binary.data());
+        header.format = format;
+
+        if (!makeDirectories(Directory()))
+            return false;
+        std::string path = Path(key), temporary = path + ".tmp";
+        FILE *out = fopen(temporary.c_str(), "wb");
+        if (!out)
+            return false;
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(binary.data(), binary.size(), 1, out) == 1;
+        ok = fclose(out) == 0 && ok;
+        // written under a temporary name first, so a reader never sees a half written file
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const uint32_t FILE_VERSION = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t format; // the binaryFormat glGetProgramBinary returned
+        uint32_t length;
+        double compileMilliseconds;
+    };
+
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat,
+                                                   void *binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+    std::string driver;
+    bool supported = false;
+
+    ProgramBinaryCache() = default;
+};
+
+#endif //PROJECT_BASE_PROGRAMBINARYCACHE_H
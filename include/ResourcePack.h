@@ -0,0 +1,157 @@
+#ifndef PROJECT_BASE_RESOURCEPACK_H
+#define PROJECT_BASE_RESOURCEPACK_H
+
+#include <MappedFile.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A single file holding many assets: the payloads one after the other, each starting at a PACK_ALIGNMENT boundary,
+// followed by the index. The pack is mapped once and every asset is a range of the mapping, so reading one costs
+// neither a system call nor a copy. Written by the project_base_pack tool, read through AssetFileSystem.
+//
+// Layout (little endian): ResourcePackHeader, payloads, then per entry a ResourcePackEntry followed by its path.
+// Every entry remembers the size and modification time of the file it was packed from.
+const uint64_t PACK_ALIGNMENT = 64;
+const uint32_t PACK_VERSION = 1;
+
+struct ResourcePackHeader {
+    char magic[4]; // "RGPK"
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t indexOffset;
+    uint64_t indexSize;
+};
+
+struct ResourcePackEntry {
+    uint64_t offset;
+    uint64_t size;
+    int64_t sourceMtime; // nanoseconds
+    uint32_t pathLength;
+    uint32_t reserved;
+};
+
+class ResourcePack {
+public:
+    struct Entry {
+        const unsigned char *data;
+        size_t size;
+        int64_t sourceMtime;
+    };
+
+    bool Open(const std::string &path) {
+        entries.clear();
+        if (!file.open(path) || file.size() < sizeof(ResourcePackHeader))
+            return fail();
+        ResourcePackHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, "RGPK", 4) != 0 || header.version != PACK_VERSION ||
+            header.indexOffset + header.indexSize > file.size())
+            return fail();
+
+        uint64_t offset = header.indexOffset, end = header.indexOffset + header.indexSize;
+        entries.reserve(header.entryCount);
+        for (uint32_t i = 0; i < header.entryCount; i++) {
+            ResourcePackEntry entry;
+            if (offset + sizeof(entry) > end)
+                return fail();
+            memcpy(&entry, file.data() + offset, sizeof(entry));
+            offset += sizeof(entry);
+            if (offset + entry.pathLength > end || entry.offset + entry.size > header.indexOffset)
+                return fail();
+            std::string entryPath((const char *) file.data() + offset, entry.pathLength);
+            offset += entry.pathLength;
+            entries[entryPath] = Entry{file.data() + entry.offset, (size_t) entry.size, entry.sourceMtime};
+        }
+        return true;
+    }
+
+    bool IsOpen() const {
+        return file.isOpen();
+    }
+
+    // nullptr when the pack has no file of that name; paths are stored relative to the directory the pack was made in
+    const Entry *Find(const std::string &path) const {
+        auto found = entries.find(path);
+        return found == entries.end() ? nullptr : &found->second;
+    }
+
+    size_t Size() const {
+        return entries.size();
+    }
+
+    size_t Bytes() const {
+        return file.size();
+    }
+
+    static int64_t ModificationTime(const struct stat &info) {
+        return (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    }
+
+    // packs the given files under the paths they are named by; false if one of them can't be read
+    static bool Write(const std::string &path, const std::vector<std::string> &files) {
+        std::string temporary = path + ".tmp";
+        FILE *out = fopen(temporary.c_str(), "wb");
+        if (!out)
+            return false;
+        ResourcePackHeader header = {};
+        memcpy(header.magic, "RGPK", 4);
+        header.version = PACK_VERSION;
+        header.entryCount = (uint32_t) files.size();
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+        std::vector<unsigned char> index;
+        uint64_t offset = sizeof(header);
+        static const unsigned char zeros[PACK_ALIGNMENT] = {};
+        for (size_t i = 0; ok && i < files.size(); i++) {
+            MappedFile source;
+            struct stat info;
+            ok = stat(files[i].c_str(), &info) == 0;
+            if (!ok)
+                break;
+            uint64_t aligned = (offset + PACK_ALIGNMENT - 1) & ~(PACK_ALIGNMENT - 1);
+            ok = aligned == offset || fwrite(zeros, aligned - offset, 1, out) == 1;
+            // empty files can't be mapped, they are packed with no payload
+            if (ok && info.st_size > 0)
+                ok = source.open(files[i]) && fwrite(source.data(), source.size(), 1, out) == 1;
+            offset = aligned + (uint64_t) info.st_size;
+
+            ResourcePackEntry entry = {aligned, (uint64_t) info.st_size, ModificationTime(info),
+                                       (uint32_t) files[i].size(), 0};
+            const unsigned char *bytes = (const unsigned char *) &entry;
+            index.insert(index.end(), bytes, bytes + sizeof(entry));
+            index.insert(index.end(), files[i].begin(), files[i].end());
+        }
+        header.indexOffset = offset;
+        header.indexSize = index.size();
+        ok = ok && (index.empty() || fwrite(index.data(), index.size(), 1, out) == 1) && fseek(out, 0, SEEK_SET) == 0 &&
+             fwrite(&header, sizeof(header), 1, out) == 1;
+        ok = fclose(out) == 0 && ok;
+        // written under a temporary name first, so a reader never sees a half written pack
+        if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+            unlink(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    MappedFile file;
+    std::unordered_map<std::string, Entry> entries;
+
+    bool fail() {
+        entries.clear();
+        file.close();
+        return false;
+    }
+};
+
+#endif //PROJECT_BASE_RESOURCEPACK_H
@@ -9,51 +9,31 @@
 #include <vector>
 #include "glad/glad.h"
 #include "Texture.h"
+#include "TextureRegistry.h"
 #include "learnopengl/filesystem.h"
 
 using namespace std;
 
 
+// faces are decoded in the background (or come from a baked cubemap file), until then the cubemap is a 1x1 placeholder
 unsigned int loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    return TextureRegistry::Instance().AcquireCubemap(faces);
 }
 
 
-vector<std::string> faces
-        {
-                FileSystem::getPath("resources/textures/skybox/xpos.png"),  //right
-                FileSystem::getPath("resources/textures/skybox/xneg.png"),  //left
-                FileSystem::getPath("resources/textures/skybox/ypos.png"),   //top
-                FileSystem::getPath("resources/textures/skybox/yneg.png"), //bottom
-                FileSystem::getPath("resources/textures/skybox/zpos.png"), //front
-                FileSystem::getPath("resources/textures/skybox/zneg.png")   //back
-        };
+// +X, -X, +Y, -Y, +Z, -Z; resolved when the skybox is loaded instead of during static initialization
+vector<std::string> skyboxFaces()
+{
+    return {
+            FileSystem::getPath("resources/textures/skybox/xpos.png"),  //right
+            FileSystem::getPath("resources/textures/skybox/xneg.png"),  //left
+            FileSystem::getPath("resources/textures/skybox/ypos.png"),   //top
+            FileSystem::getPath("resources/textures/skybox/yneg.png"), //bottom
+            FileSystem::getPath("resources/textures/skybox/zpos.png"), //front
+            FileSystem::getPath("resources/textures/skybox/zneg.png")   //back
+    };
+}
 
 float skyboxVertices[] = {
         // positions
@@ -10,51 +10,16 @@
 #include "glad/glad.h"
 #include "stb_image.h"
 #include "learnopengl/shader.h"
+#include "TextureRegistry.h"
 
 
 unsigned int loadTexture(const char *path);
 
+// returns immediately with a placeholder, the image is decoded in the background and uploaded by TextureLoader::Update.
+// images already loaded by a model or another call are shared through the TextureRegistry.
 unsigned int loadTexture(char const * path)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1) {
-            format = GL_RED;
-        }
-        else if (nrComponents == 3) {
-            format = GL_RGB;
-        }
-        else if (nrComponents == 4) {
-            format = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, textureID);
-
-        //Mora jer neke teksture nisu korektne rezolucije (faktora 4)
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return TextureRegistry::Instance().Acquire2D(path);
 }
 
 #endif //PROJECT_BASE_TEXTURE_H
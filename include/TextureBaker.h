@@ -0,0 +1,291 @@
+#ifndef PROJECT_BASE_TEXTUREBAKER_H
+#define PROJECT_BASE_TEXTUREBAKER_H
+
+#include <AssetFileSystem.h>
+#include <BlockCompression.h>
+#include <KtxFile.h>
+#include <ThreadPool.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Offline conversion of source images into baked KTX files (see KtxFile.h), used by the project_base_bake tool.
+// The format follows the image:
+//   one channel                    -> BC4, sampled as (r, 0, 0, 1) like the GL_RED upload of the source
+//   grey RGB, opaque               -> BC4 with a (r, r, r, 1) swizzle, a quarter of BC1's error at the same size
+//   RGB or RGBA with opaque alpha  -> BC1
+//   anything with alpha            -> BC3
+struct TextureBakeResult {
+    bool ok = false;
+    uint32_t internalFormat = 0;
+    int width = 0, height = 0;
+    size_t uncompressedBytes = 0; // what the source takes as an uncompressed texture with mips
+    size_t bakedBytes = 0;
+    bool gammaAware = false;      // mips filtered in linear light
+};
+
+// Mip levels are resampled with a Kaiser windowed sinc, which keeps them sharper than a box filter without visible
+// ringing. Color is filtered in linear light: averaging sRGB values directly darkens every level below the first.
+// Alpha and data textures (single channel, specular, normal, ao, roughness, height ... maps) are filtered as stored.
+const float MIP_FILTER_RADIUS = 2.0f; // in destination pixels
+const float MIP_FILTER_ALPHA = 4.0f;  // Kaiser window shape, larger is smoother
+
+// whether the RGB channels of a source hold sRGB encoded color rather than data
+bool isColorTexture(const std::string &path, int channels) {
+    if (channels < 3)
+        return false;
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    for (char &c : name)
+        c = (char) tolower(c);
+    static const char *dataSuffixes[] = {"spec", "normal", "nrm", "bump", "height", "disp", "rough", "metal", "_ao", "occlusion"};
+    for (const char *suffix : dataSuffixes)
+        if (name.find(suffix) != std::string::npos)
+            return false;
+    return name.compare(0, 3, "ao.") != 0;
+}
+
+struct MipImage {
+    int width = 0, height = 0;
+    std::vector<float> pixels; // RGBA, linear light for color textures
+};
+
+float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+MipImage toMipImage(const std::vector<uint8_t> &rgba, int width, int height, bool srgb) {
+    float decode[256];
+    for (int i = 0; i < 256; i++)
+        decode[i] = srgb ? srgbToLinear(i / 255.0f) : i / 255.0f;
+    MipImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(rgba.size());
+    for (size_t i = 0; i < rgba.size(); i++)
+        image.pixels[i] = i % 4 == 3 ? rgba[i] / 255.0f : decode[rgba[i]];
+    return image;
+}
+
+std::vector<uint8_t> toBytes(const MipImage &image, bool srgb) {
+    std::vector<uint8_t> rgba(image.pixels.size());
+    for (size_t i = 0; i < rgba.size(); i++) {
+        float value = std::min(std::max(image.pixels[i], 0.0f), 1.0f);
+        if (srgb && i % 4 != 3)
+            value = linearToSrgb(value);
+        rgba[i] = (uint8_t) std::lround(value * 255.0f);
+    }
+    return rgba;
+}
+
+float besselI0(float x) {
+    // power series, converges quickly for the small arguments of the window
+    float sum = 1.0f, term = 1.0f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+float kaiserSinc(float x) {
+    if (std::fabs(x) >= MIP_FILTER_RADIUS)
+        return 0.0f;
+    float t = x / MIP_FILTER_RADIUS;
+    float window = besselI0(MIP_FILTER_ALPHA * std::sqrt(1.0f - t * t)) / besselI0(MIP_FILTER_ALPHA);
+    float sinc = x == 0.0f ? 1.0f : std::sin(3.14159265f * x) / (3.14159265f * x);
+    return sinc * window;
+}
+
+struct MipTap {
+    int source;
+    float weight;
+};
+
+// normalized filter taps of every destination pixel along one axis; wrap repeats the image like GL_REPEAT
+std::vector<std::vector<MipTap>> mipTaps(int sourceSize, int destinationSize, bool wrap) {
+    std::vector<std::vector<MipTap>> taps(destinationSize);
+    float scale = (float) sourceSize / destinationSize;
+    for (int x = 0; x < destinationSize; x++) {
+        float center = (x + 0.5f) * scale;
+        int first = (int) std::floor(center - MIP_FILTER_RADIUS * scale), last = (int) std::ceil(center + MIP_FILTER_RADIUS * scale);
+        float sum = 0.0f;
+        for (int i = first; i <= last; i++) {
+            float weight = kaiserSinc((i + 0.5f - center) / scale);
+            if (weight == 0.0f)
+                continue;
+            int source = wrap ? ((i % sourceSize) + sourceSize) % sourceSize : std::min(std::max(i, 0), sourceSize - 1);
+            taps[x].push_back(MipTap{source, weight});
+            sum += weight;
+        }
+        for (MipTap &tap : taps[x])
+            tap.weight /= sum;
+    }
+    return taps;
+}
+
+// the next level of a mip chain, half the size and at least 1x1, filtered separably
+MipImage downsample(const MipImage &image, bool wrap) {
+    MipImage horizontal, result;
+    horizontal.width = result.width = std::max(image.width / 2, 1);
+    horizontal.height = image.height;
+    result.height = std::max(image.height / 2, 1);
+    horizontal.pixels.resize((size_t) horizontal.width * horizontal.height * 4);
+    result.pixels.resize((size_t) result.width * result.height * 4);
+
+    std::vector<std::vector<MipTap>> columns = mipTaps(image.width, horizontal.width, wrap);
+    ThreadPool::Shared().ParallelFor((size_t) image.height, [&](size_t y) {
+        const float *row = image.pixels.data() + y * image.width * 4;
+        float *out = horizontal.pixels.data() + y * horizontal.width * 4;
+        for (int x = 0; x < horizontal.width; x++) {
+            float sum[4] = {0, 0, 0, 0};
+            for (const MipTap &tap : columns[x])
+                for (int c = 0; c < 4; c++)
+                    sum[c] += row[tap.source * 4 + c] * tap.weight;
+            memcpy(out + x * 4, sum, sizeof(sum));
+        }
+    });
+
+    std::vector<std::vector<MipTap>> rows = mipTaps(image.height, result.height, wrap);
+    ThreadPool::Shared().ParallelFor((size_t) result.height, [&](size_t y) {
+        float *out = result.pixels.data() + y * result.width * 4;
+        for (const MipTap &tap : rows[y]) {
+            const float *row = horizontal.pixels.data() + (size_t) tap.source * result.width * 4;
+            for (int i = 0; i < result.width * 4; i++)
+                out[i] += row[i] * tap.weight;
+        }
+    });
+    return result;
+}
+
+std::vector<unsigned char> compressLevel(const std::vector<uint8_t> &pixels, int width, int height, uint32_t internalFormat) {
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    size_t blockBytes = KtxFile::BlockBytes(internalFormat);
+    std::vector<unsigned char> blocks((size_t) blocksX * blocksY * blockBytes);
+    ThreadPool::Shared().ParallelFor((size_t) blocksY, [&](size_t blockY) {
+        uint8_t block[64];
+        for (int blockX = 0; blockX < blocksX; blockX++) {
+            BlockCompression::GatherBlock(pixels.data(), width, height, blockX, (int) blockY, block);
+            unsigned char *out = blocks.data() + ((size_t) blockY * blocksX + blockX) * blockBytes;
+            if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+                BlockCompression::EncodeBC1(block, out);
+            else if (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+                BlockCompression::EncodeBC3(block, out);
+            else
+                BlockCompression::EncodeBC4(block, 0, out);
+        }
+    });
+    return blocks;
+}
+
+// bakes one image, or the six faces of a cubemap which have to be square and of the same size
+TextureBakeResult bakeImages(const std::vector<std::string> &sourcePaths, bool flip) {
+    TextureBakeResult result;
+    bool cubemap = sourcePaths.size() == 6;
+    std::vector<std::vector<uint8_t>> faces(sourcePaths.size());
+    std::vector<int> widths(faces.size()), heights(faces.size()), channelCounts(faces.size());
+    std::vector<uint64_t> fileHashes(faces.size());
+    ThreadPool::Shared().ParallelFor(faces.size(), [&](size_t face) {
+        AssetFile file(sourcePaths[face]);
+        if (file.isOpen())
+            fileHashes[face] = fnv1a64(file.data(), file.size());
+        unsigned char *source = file.isOpen() ? stbi_load_from_memory(file.data(), (int) file.size(), &widths[face], &heights[face],
+                                                                      &channelCounts[face], 4) : nullptr;
+        if (!source)
+            return;
+        faces[face].assign(source, source + (size_t) widths[face] * heights[face] * 4);
+        stbi_image_free(source);
+    });
+    for (size_t face = 0; face < faces.size(); face++)
+        if (faces[face].empty() || widths[face] != widths[0] || heights[face] != heights[0] || (cubemap && widths[0] != heights[0]))
+            return result;
+    int width = result.width = widths[0], height = result.height = heights[0];
+    int channels = *std::max_element(channelCounts.begin(), channelCounts.end());
+    if (flip) {
+        size_t stride = (size_t) width * 4;
+        for (std::vector<uint8_t> &pixels : faces)
+            for (int y = 0; y < height / 2; y++)
+                std::swap_ranges(pixels.begin() + y * stride, pixels.begin() + (y + 1) * stride,
+                                 pixels.begin() + (height - 1 - y) * stride);
+    }
+
+    bool opaque = true, grey = true;
+    for (const std::vector<uint8_t> &pixels : faces) {
+        for (size_t i = 0; i < pixels.size(); i += 4) {
+            opaque &= pixels[i + 3] == 255;
+            grey &= pixels[i] == pixels[i + 1] && pixels[i] == pixels[i + 2];
+        }
+    }
+    std::string swizzle;
+    uint32_t baseFormat;
+    if (channels == 1 || (grey && opaque && channels != 2)) {
+        result.internalFormat = GL_COMPRESSED_RED_RGTC1;
+        baseFormat = GL_RED;
+        if (channels != 1)
+            swizzle = "rrr1";
+    } else if (opaque) {
+        result.internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        baseFormat = GL_RGB;
+    } else {
+        result.internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        baseFormat = GL_RGBA;
+    }
+
+    // the upload path of the source: GL_RED, GL_RGB or GL_RGBA, 8 bits per channel, plus a third for the mips
+    // of a 2D texture (the decoded cubemap has none)
+    size_t sourceBytes = (size_t) width * height * (channels == 1 ? 1 : channels == 4 ? 4 : 3) * faces.size();
+    result.uncompressedBytes = cubemap ? sourceBytes : sourceBytes * 4 / 3;
+
+    // every level is filtered from the previous one in float, only the compressed copy is quantized. 2D textures
+    // repeat at their edges, cubemap faces are clamped
+    bool srgb = isColorTexture(sourcePaths[0], channels);
+    result.gammaAware = srgb;
+    std::vector<std::vector<std::vector<unsigned char>>> faceLevels(faces.size());
+    for (size_t face = 0; face < faces.size(); face++) {
+        std::vector<uint8_t> pixels = std::move(faces[face]);
+        MipImage level = toMipImage(pixels, width, height, srgb);
+        while (true) {
+            if (faceLevels[face].size() > 0)
+                pixels = toBytes(level, srgb);
+            faceLevels[face].push_back(compressLevel(pixels, level.width, level.height, result.internalFormat));
+            result.bakedBytes += faceLevels[face].back().size();
+            if (level.width == 1 && level.height == 1)
+                break;
+            level = downsample(level, !cubemap);
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> keyValues;
+    keyValues.push_back(std::make_pair(std::string("RGSourceStamp"), KtxFile::SourceStamp(sourcePaths)));
+    keyValues.push_back(std::make_pair(std::string("RGBakeVersion"), std::to_string(KtxFile::BAKE_VERSION)));
+    keyValues.push_back(std::make_pair(std::string("RGMipFilter"), srgb ? "kaiser-srgb" : "kaiser"));
+    char sourceHash[17];
+    snprintf(sourceHash, sizeof(sourceHash), "%016llx", (unsigned long long) KtxFile::SourceHash(fileHashes, flip));
+    keyValues.push_back(std::make_pair(std::string("RGSourceHash"), std::string(sourceHash)));
+    if (!swizzle.empty())
+        keyValues.push_back(std::make_pair(std::string("RGSwizzle"), swizzle));
+    result.ok = KtxFile::Write(KtxFile::BakedPath(sourcePaths, flip), result.internalFormat, baseFormat,
+                               (uint32_t) width, (uint32_t) height, faceLevels, keyValues);
+    return result;
+}
+
+TextureBakeResult BakeTexture(const std::string &sourcePath, bool flip) {
+    return bakeImages(std::vector<std::string>{sourcePath}, flip);
+}
+
+// faces in the order +X, -X, +Y, -Y, +Z, -Z, like TextureLoader::LoadCubemap
+TextureBakeResult BakeCubemap(const std::vector<std::string> &facePaths, bool flip) {
+    return bakeImages(facePaths, flip);
+}
+
+#endif //PROJECT_BASE_TEXTUREBAKER_H
@@ -0,0 +1,552 @@
+#ifndef PROJECT_BASE_TEXTURELOADER_H
+#define PROJECT_BASE_TEXTURELOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <AssetFileSystem.h>
+#include <KtxFile.h>
+#include <PixelUploadRing.h>
+#include <ThreadPool.h>
+#include <Timer.h>
+#include <UploadContext.h>
+#include <common.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Asynchronous texture loading. Load2D/LoadCubemap create the texture right away with a 1x1 placeholder and
+// return its id, while the image is decoded on the shared thread pool. Update() runs on the GL thread once per
+// frame and uploads finished images into the same texture objects, limited by a byte budget so that texture
+// arrival never causes a frame spike.
+//
+// 2D textures stream in one mip level at a time, starting from the smallest: GL_TEXTURE_BASE_LEVEL is clamped to
+// the lowest level uploaded so far, so a texture is sampled at its full size only once the top level arrived and
+// is usable at low resolution long before that. Each Update uploads the smallest pending level of all textures
+// first, which brings every texture to a coarse mip before any large level is spent on one of them. The mip chain
+// of a decoded image is built on the worker with a 2x2 box filter (what glGenerateMipmap did), baked files bring
+// their own.
+//
+// With the UploadContext running, the level data is uploaded on its thread and Update() only moves the base level
+// of each texture once the fence after its upload has signaled.
+//
+// Pixels reach the driver through a PixelUploadRing: staged in pixel unpack buffers and fenced, not copied out
+// of client memory by each glTexImage2D.
+//
+// Images are flipped by the loader itself instead of through stbi_set_flip_vertically_on_load, whose global
+// flag would race with decodes running on the workers.
+//
+// 2D textures with an up to date baked KTX file (see KtxFile.h, made by the project_base_bake tool) skip the
+// decode: the job maps the file and the blocks of each mip level go straight to glCompressedTexImage2D. A cubemap
+// baked into one file is uploaded with all faces and mips in a single step, otherwise its six faces are decoded
+// concurrently and uploaded without mips as before. Sources
+// without a baked file, or with a format the driver doesn't support, are decoded as before.
+class TextureLoader {
+public:
+    static TextureLoader &Instance() {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    // applies to the loads issued after it is set, like stbi_set_flip_vertically_on_load used to
+    static bool &FlipVertically() {
+        static bool flip = false;
+        return flip;
+    }
+
+    unsigned int Load2D(const std::string &path) {
+        unsigned int textureID = createPlaceholder(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        submit(textureID, GL_TEXTURE_2D, std::vector<std::string>{path}, S3tcSupported());
+        return textureID;
+    }
+
+    // BC4 (RGTC) is core in GL 3.0, BC1 and BC3 need EXT_texture_compression_s3tc; queried once on the GL thread
+    static bool S3tcSupported() {
+        static int supported = -1;
+        if (supported < 0) {
+            supported = 0;
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count; i++) {
+                const char *name = (const char *) glGetStringi(GL_EXTENSIONS, i);
+                if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                    supported = 1;
+            }
+        }
+        return supported == 1;
+    }
+
+    // textures uploaded from baked files so far
+    size_t CompressedTextures() const {
+        return compressedTextures;
+    }
+
+    // every level and face uploaded so far, with the time the uploads took on the thread that issued them: the
+    // loader thread while the UploadContext runs. Handed over with the done callbacks, so read on the main thread
+    const PixelUploadRing::Stats &UploadStats() const {
+        return uploadStats;
+    }
+
+    // main thread time per level for queueing it and making it visible once it arrived, which includes the upload
+    // itself when there is no UploadContext
+    double MainThreadMillisecondsPerLevel() const {
+        return uploadedLevels > 0 ? mainThreadMilliseconds / uploadedLevels : 0.0;
+    }
+
+    // faces in the order +X, -X, +Y, -Y, +Z, -Z
+    unsigned int LoadCubemap(const std::vector<std::string> &faces) {
+        unsigned int textureID = createPlaceholder(GL_TEXTURE_CUBE_MAP);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        submit(textureID, GL_TEXTURE_CUBE_MAP, faces, S3tcSupported());
+        return textureID;
+    }
+
+    // uploads mip levels of decoded images, smallest first, until the byte budget is spent; at least one level per
+    // call so nothing starves. While the UploadContext runs, the levels go to its thread and the budget limits
+    // the bytes queued there; a level counts as uploaded once its done callback ran here.
+    void Update(size_t byteBudget) {
+        UploadContext::Instance().Poll();
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            while (!state->ready.empty()) {
+                std::shared_ptr<DecodedTexture> texture(std::move(state->ready.front()));
+                state->ready.pop_front();
+                if (forgotten.erase(texture->request)) {
+                    pending--;
+                    continue;
+                }
+                contentHashes[texture->textureID] = texture->contentHash;
+                streaming.push_back(std::move(texture));
+            }
+        }
+
+        size_t uploaded = queuedBytes;
+        while (true) {
+            std::shared_ptr<DecodedTexture> next;
+            for (const std::shared_ptr<DecodedTexture> &texture : streaming)
+                if (texture->submittedLevel > 0 && (!next || texture->NextLevelBytes() < next->NextLevelBytes()))
+                    next = texture;
+            if (!next)
+                break;
+            size_t bytes = next->NextLevelBytes();
+            if (uploaded > 0 && uploaded + bytes > byteBudget)
+                break;
+            uploaded += bytes;
+            submitNextLevel(next);
+        }
+    }
+
+    // blocks until every requested texture has been decoded and uploaded
+    void Finish() {
+        while (pending > 0) {
+            UploadContext::Instance().Finish();
+            if (pending == 0)
+                break;
+            if (streaming.empty()) {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->decoded.wait(lock, [this] { return !state->ready.empty(); });
+            }
+            Update(SIZE_MAX);
+        }
+    }
+
+    // textures requested but not fully resident yet, including those still streaming in their upper mips
+    size_t Pending() const {
+        return pending;
+    }
+
+    // textures that are usable at a reduced resolution while their upper mips are still on the way
+    size_t Streaming() const {
+        return streaming.size();
+    }
+
+    // GPU memory of the levels of a texture uploaded so far, 0 while it is still a placeholder
+    size_t ResidentBytes(unsigned int textureID) const {
+        auto found = residentBytes.find(textureID);
+        return found != residentBytes.end() ? found->second : 0;
+    }
+
+    struct LoadTime {
+        double decodeMilliseconds = 0.0;   // decoding the images, or mapping the baked file, on the worker
+        double residentMilliseconds = 0.0; // from the request until every level was uploaded
+        bool baked = false;
+    };
+
+    // KtxFile::SourceHash of the source images, computed on the worker from the bytes it decoded or taken from the
+    // baked file; 0 until the job is done or when a file could not be read
+    uint64_t ContentHash(unsigned int textureID) const {
+        auto found = contentHashes.find(textureID);
+        return found != contentHashes.end() ? found->second : 0;
+    }
+
+    // zero until the texture is fully resident
+    LoadTime GetLoadTime(unsigned int textureID) const {
+        auto found = loadTimes.find(textureID);
+        return found != loadTimes.end() ? found->second : LoadTime();
+    }
+
+    // called before a texture is deleted, a decode still in flight for it is dropped instead of uploaded. The
+    // decode is found by its request, not by the texture name, which glGenTextures may hand out again right away
+    void Forget(unsigned int textureID) {
+        // a level on the upload thread binds the texture by name, which must stay valid until it is done
+        bool uploading = false;
+        for (const std::shared_ptr<DecodedTexture> &texture : streaming)
+            uploading |= texture->textureID == textureID && texture->submittedLevel != texture->lowestLevel;
+        if (uploading)
+            UploadContext::Instance().Finish();
+        residentBytes.erase(textureID);
+        loadTimes.erase(textureID);
+        contentHashes.erase(textureID);
+        auto found = inFlight.find(textureID);
+        if (found == inFlight.end())
+            return;
+        uint64_t request = found->second;
+        inFlight.erase(found);
+        for (size_t i = 0; i < streaming.size(); i++) {
+            if (streaming[i]->request == request) {
+                streaming.erase(streaming.begin() + i);
+                pending--;
+                return;
+            }
+        }
+        forgotten.insert(request);
+    }
+
+private:
+    struct DecodedImage {
+        std::string path;
+        unsigned char *pixels = nullptr;
+        int width = 0, height = 0, channels = 0;
+        uint64_t fileHash = 0; // of the encoded file, 0 when it could not be read
+        std::vector<std::vector<unsigned char>> mips; // levels 1 and up of a decoded 2D image
+        std::shared_ptr<KtxFile> baked; // set instead of pixels when the image comes from a baked file
+    };
+
+    struct DecodedTexture {
+        unsigned int textureID;
+        uint64_t request; // sequence number of the Load2D/LoadCubemap call
+        GLenum target;
+        std::vector<DecodedImage> images;
+        size_t bytes = 0;
+        // the levels from lowestLevel up are resident, the ones from submittedLevel up are uploaded or on their way;
+        // a cubemap or a failed decode is a single step
+        int levelCount = 1;
+        int lowestLevel = 1;
+        int submittedLevel = 1;
+        Timer requested;
+        double decodeMilliseconds = 0.0;
+        uint64_t contentHash = 0;
+
+        // a 2D image that was decoded or comes from a baked file
+        bool HasMips() const {
+            return target == GL_TEXTURE_2D && (images[0].pixels || images[0].baked);
+        }
+
+        size_t NextLevelBytes() const {
+            if (!HasMips())
+                return bytes;
+            int level = submittedLevel - 1;
+            if (images[0].baked)
+                return images[0].baked->levels[level].size;
+            return level == 0 ? (size_t) images[0].width * images[0].height * images[0].channels : images[0].mips[level - 1].size();
+        }
+
+        ~DecodedTexture() {
+            for (DecodedImage &image : images)
+                stbi_image_free(image.pixels);
+        }
+    };
+
+    // shared with the decode jobs, so a job finishing during shutdown never touches a destroyed loader
+    struct SharedState {
+        std::mutex mutex;
+        std::condition_variable decoded;
+        std::deque<std::unique_ptr<DecodedTexture>> ready;
+    };
+
+    std::shared_ptr<SharedState> state = std::make_shared<SharedState>();
+    std::vector<std::shared_ptr<DecodedTexture>> streaming; // partly uploaded, owned by the main thread
+    size_t queuedBytes = 0; // of the levels on the upload thread
+    PixelUploadRing uploadRing; // used by whichever thread uploads
+    PixelUploadRing::Stats uploadStats; // the ring's stats as of the last level whose done callback ran
+    double mainThreadMilliseconds = 0.0;
+    size_t uploadedLevels = 0;
+    size_t pending = 0;
+    size_t compressedTextures = 0;
+    std::unordered_map<unsigned int, size_t> residentBytes;
+    std::unordered_map<unsigned int, LoadTime> loadTimes;
+    std::unordered_map<unsigned int, uint64_t> contentHashes;
+    uint64_t requests = 0;
+    std::unordered_map<unsigned int, uint64_t> inFlight; // texture name to the request still loading into it
+    std::unordered_set<uint64_t> forgotten;              // requests whose decode is dropped when it arrives
+
+    TextureLoader() = default;
+
+    static unsigned int createPlaceholder(GLenum target) {
+        static const unsigned char grey[3] = {128, 128, 128};
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(target, textureID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (target == GL_TEXTURE_CUBE_MAP) {
+            for (unsigned int i = 0; i < 6; i++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+        } else {
+            glTexImage2D(target, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+        }
+        return textureID;
+    }
+
+    void submit(unsigned int textureID, GLenum target, std::vector<std::string> paths, bool s3tc) {
+        pending++;
+        uint64_t request = ++requests;
+        inFlight[textureID] = request;
+        bool flip = FlipVertically();
+        Timer requested;
+        std::shared_ptr<SharedState> shared = state;
+        ThreadPool::Shared().Submit([shared, textureID, request, target, paths, flip, s3tc, requested]() {
+            std::unique_ptr<DecodedTexture> texture(new DecodedTexture);
+            texture->textureID = textureID;
+            texture->request = request;
+            texture->target = target;
+            Timer decodeTimer;
+            DecodedImage baked;
+            if (openBaked(paths, flip, s3tc, baked)) {
+                texture->bytes = baked.baked->TotalBytes();
+                // a baked cubemap goes up in one step with all its faces and levels
+                if (target == GL_TEXTURE_2D)
+                    texture->levelCount = (int) baked.baked->levels.size();
+                // bakes older than the stored hash cost a read of the sources, still off the main thread
+                texture->contentHash = baked.baked->StoredSourceHash();
+                if (texture->contentHash == 0)
+                    texture->contentHash = KtxFile::SourceHash(paths, flip);
+                texture->images.push_back(baked);
+            } else {
+                // the faces of a cubemap decode concurrently, ParallelFor is safe to call from a pool job
+                texture->images.resize(paths.size());
+                ThreadPool::Shared().ParallelFor(paths.size(), [&](size_t i) {
+                    DecodedImage &image = texture->images[i];
+                    image.path = paths[i];
+                    AssetFile file(paths[i]);
+                    if (file.isOpen()) {
+                        image.fileHash = fnv1a64(file.data(), file.size());
+                        image.pixels = stbi_load_from_memory(file.data(), (int) file.size(), &image.width, &image.height,
+                                                             &image.channels, 0);
+                    }
+                    if (image.pixels && flip)
+                        flipRows(image);
+                    if (image.pixels && target == GL_TEXTURE_2D)
+                        buildMips(image);
+                });
+                std::vector<uint64_t> fileHashes;
+                for (const DecodedImage &image : texture->images) {
+                    texture->bytes += (size_t) image.width * image.height * image.channels;
+                    fileHashes.push_back(image.fileHash);
+                }
+                texture->contentHash = KtxFile::SourceHash(fileHashes, flip);
+                if (target == GL_TEXTURE_2D && texture->images[0].pixels)
+                    texture->levelCount = (int) texture->images[0].mips.size() + 1;
+            }
+            texture->lowestLevel = texture->submittedLevel = texture->levelCount;
+            texture->decodeMilliseconds = decodeTimer.Milliseconds();
+            texture->requested = requested;
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->ready.push_back(std::move(texture));
+            }
+            shared->decoded.notify_all();
+        });
+    }
+
+    static bool openBaked(const std::vector<std::string> &paths, bool flip, bool s3tc, DecodedImage &image) {
+        std::shared_ptr<KtxFile> baked = std::make_shared<KtxFile>();
+        if (!baked->OpenBaked(paths, flip) || (!s3tc && baked->internalFormat != GL_COMPRESSED_RED_RGTC1))
+            return false;
+        image.path = paths[0];
+        image.baked = baked;
+        image.width = (int) baked->width;
+        image.height = (int) baked->height;
+        return true;
+    }
+
+    // the mip chain of a decoded image down to 1x1, every texel the average of the 2x2 texels above it
+    static void buildMips(DecodedImage &image) {
+        const unsigned char *source = image.pixels;
+        int width = image.width, height = image.height, channels = image.channels;
+        while (width > 1 || height > 1) {
+            int mipWidth = std::max(width / 2, 1), mipHeight = std::max(height / 2, 1);
+            std::vector<unsigned char> mip((size_t) mipWidth * mipHeight * channels);
+            for (int y = 0; y < mipHeight; y++) {
+                const unsigned char *row0 = source + (size_t) std::min(2 * y, height - 1) * width * channels;
+                const unsigned char *row1 = source + (size_t) std::min(2 * y + 1, height - 1) * width * channels;
+                unsigned char *out = mip.data() + (size_t) y * mipWidth * channels;
+                for (int x = 0; x < mipWidth; x++) {
+                    int x0 = std::min(2 * x, width - 1) * channels, x1 = std::min(2 * x + 1, width - 1) * channels;
+                    for (int c = 0; c < channels; c++)
+                        out[x * channels + c] = (unsigned char) ((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                }
+            }
+            image.mips.push_back(std::move(mip));
+            source = image.mips.back().data();
+            width = mipWidth;
+            height = mipHeight;
+        }
+    }
+
+    static void flipRows(DecodedImage &image) {
+        size_t stride = (size_t) image.width * image.channels;
+        std::vector<unsigned char> row(stride);
+        for (int y = 0; y < image.height / 2; y++) {
+            unsigned char *top = image.pixels + y * stride;
+            unsigned char *bottom = image.pixels + (image.height - 1 - y) * stride;
+            memcpy(row.data(), top, stride);
+            memcpy(top, bottom, stride);
+            memcpy(bottom, row.data(), stride);
+        }
+    }
+
+    static GLenum formatFor(int channels) {
+        if (channels == 1)
+            return GL_RED;
+        if (channels == 4)
+            return GL_RGBA;
+        return GL_RGB;
+    }
+
+    // grey images are stored in the red channel only
+    static void applySwizzle(GLenum target, const KtxFile &baked) {
+        if (baked.Value("RGSwizzle") == "rrr1") {
+            GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+            glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+    }
+
+    // the level data goes up on the upload thread, the texture parameters change here once it has arrived
+    void submitNextLevel(const std::shared_ptr<DecodedTexture> &texture) {
+        size_t bytes = texture->NextLevelBytes();
+        int level = --texture->submittedLevel;
+        queuedBytes += bytes;
+        std::shared_ptr<PixelUploadRing::Stats> ringStats = std::make_shared<PixelUploadRing::Stats>();
+        // without the UploadContext the done callback runs inside Submit, the outer time then covers both
+        double before = mainThreadMilliseconds;
+        Timer timer;
+        UploadContext::Instance().Submit([this, texture, level, ringStats] {
+                                             uploadLevel(*texture, level);
+                                             *ringStats = uploadRing.GetStats();
+                                         },
+                                         [this, texture, level, bytes, ringStats] {
+                                             Timer doneTimer;
+                                             queuedBytes -= bytes;
+                                             uploadStats = *ringStats;
+                                             uploadedLevels++;
+                                             levelUploaded(*texture, level, bytes);
+                                             mainThreadMilliseconds += doneTimer.Milliseconds();
+                                         });
+        mainThreadMilliseconds = before + timer.Milliseconds();
+    }
+
+    // uploads one level of a 2D texture, or everything of a cubemap, on the thread with a current context
+    void uploadLevel(const DecodedTexture &texture, int level) {
+        glBindTexture(texture.target, texture.textureID);
+        //Mora jer neke teksture nisu korektne rezolucije (faktora 4)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        const DecodedImage &first = texture.images[0];
+        if (texture.HasMips()) {
+            if (first.baked) {
+                const KtxFile::Level &entry = first.baked->levels[level];
+                uploadRing.Upload(first.baked->Data(level), entry.size, [&](const void *data) {
+                    glCompressedTexImage2D(GL_TEXTURE_2D, level, first.baked->internalFormat, entry.width, entry.height, 0,
+                                           entry.size, data);
+                });
+            } else {
+                GLenum format = formatFor(first.channels);
+                int width = std::max(first.width >> level, 1), height = std::max(first.height >> level, 1);
+                uploadRing.Upload(level == 0 ? first.pixels : first.mips[level - 1].data(), (size_t) width * height * first.channels,
+                                  [&](const void *data) {
+                                      glTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+                                  });
+            }
+            return;
+        }
+        if (first.baked) {
+            for (uint32_t level = 0; level < first.baked->levels.size(); level++) {
+                const KtxFile::Level &entry = first.baked->levels[level];
+                for (uint32_t face = 0; face < 6; face++)
+                    uploadRing.Upload(first.baked->Data(level, face), entry.size, [&](const void *data) {
+                        glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, first.baked->internalFormat,
+                                               entry.width, entry.height, 0, entry.size, data);
+                    });
+            }
+            return;
+        }
+        for (unsigned int i = 0; i < texture.images.size(); i++) {
+            const DecodedImage &image = texture.images[i];
+            if (!image.pixels) {
+                std::cout << "Texture failed to load at path: " << image.path << std::endl;
+                continue;
+            }
+            GLenum format = formatFor(image.channels);
+            GLenum target = texture.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + i : texture.target;
+            uploadRing.Upload(image.pixels, (size_t) image.width * image.height * image.channels, [&](const void *data) {
+                glTexImage2D(target, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, data);
+            });
+        }
+    }
+
+    // makes an uploaded level visible by lowering the base level to it, and finishes the texture with its last level
+    void levelUploaded(DecodedTexture &texture, int level, size_t bytes) {
+        texture.lowestLevel = level;
+        const DecodedImage &first = texture.images[0];
+        glBindTexture(texture.target, texture.textureID);
+        if (texture.HasMips()) {
+            if (level == texture.levelCount - 1) {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+                if (first.baked)
+                    applySwizzle(GL_TEXTURE_2D, *first.baked);
+            }
+            // the levels below the base are ignored, including the placeholder in level 0 until it is replaced
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        } else if (first.baked) {
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint) first.baked->levels.size() - 1);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            applySwizzle(GL_TEXTURE_CUBE_MAP, *first.baked);
+        }
+        residentBytes[texture.textureID] += bytes;
+        if (level > 0)
+            return;
+
+        if (first.baked)
+            compressedTextures++;
+        LoadTime &time = loadTimes[texture.textureID];
+        time.decodeMilliseconds = texture.decodeMilliseconds;
+        time.residentMilliseconds = texture.requested.Milliseconds();
+        time.baked = first.baked != nullptr;
+        pending--;
+        inFlight.erase(texture.textureID);
+        for (size_t i = 0; i < streaming.size(); i++) {
+            if (streaming[i].get() == &texture) {
+                streaming.erase(streaming.begin() + i);
+                break;
+            }
+        }
+    }
+};
+
+#endif //PROJECT_BASE_TEXTURELOADER_H
@@ -0,0 +1,201 @@
+#ifndef PROJECT_BASE_TEXTUREREGISTRY_H
+#define PROJECT_BASE_TEXTUREREGISTRY_H
+
+#include <glad/glad.h>
+#include <AssetFileSystem.h>
+#include <KtxFile.h>
+#include <TextureLoader.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Process wide registry of loaded textures. Every image exists once in GPU memory no matter how many models or
+// materials use it: lookups go by canonical path first and by the contents of the files second, so the same image
+// stored under two names is shared as well. Identical files have the same size, so the contents are only compared
+// when a loaded texture has files of exactly the sizes requested. The hash of a loaded texture comes from its decode
+// job (TextureLoader::ContentHash) or its baked file; the requested files are only read on the main thread in that
+// rare case, every other request costs a stat per file. Textures are reference counted and deleted with the last
+// Release.
+class TextureRegistry {
+public:
+    struct Stats {
+        size_t requests = 0;
+        size_t pathHits = 0;
+        size_t contentHits = 0;
+        size_t contentChecks = 0; // requests whose contents were hashed on the main thread to compare them
+        size_t textures = 0;
+        size_t residentBytes = 0;
+        size_t savedBytes = 0;
+    };
+
+    static TextureRegistry &Instance() {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // returns the texture of the image at path and adds a reference to it, loading it only the first time
+    unsigned int Acquire2D(const std::string &path) {
+        bool flip = TextureLoader::FlipVertically();
+        std::vector<std::string> paths{path};
+        return acquire(paths, flip, [&paths]() { return TextureLoader::Instance().Load2D(paths[0]); });
+    }
+
+    unsigned int AcquireCubemap(const std::vector<std::string> &faces) {
+        bool flip = TextureLoader::FlipVertically();
+        return acquire(faces, flip, [&faces]() { return TextureLoader::Instance().LoadCubemap(faces); });
+    }
+
+    void Release(unsigned int textureID) {
+        auto found = entries.find(textureID);
+        if (found == entries.end() || --found->second.references > 0)
+            return;
+        Entry &entry = found->second;
+        for (const std::string &key : entry.pathKeys)
+            byPath.erase(key);
+        auto sameSize = bySize.find(entry.sizeKey);
+        if (sameSize != bySize.end()) {
+            std::vector<unsigned int> &textures = sameSize->second;
+            textures.erase(std::remove(textures.begin(), textures.end(), textureID), textures.end());
+            if (textures.empty())
+                bySize.erase(sameSize);
+        }
+        TextureLoader::Instance().Forget(textureID);
+        glDeleteTextures(1, &textureID);
+        entries.erase(found);
+    }
+
+    // every request beyond the first one for an image saved a decode and an upload of that image
+    Stats GetStats() const {
+        Stats stats = counters;
+        stats.textures = entries.size();
+        for (const auto &item : entries) {
+            size_t bytes = TextureLoader::Instance().ResidentBytes(item.first);
+            stats.residentBytes += bytes;
+            stats.savedBytes += bytes * item.second.sharedRequests;
+        }
+        return stats;
+    }
+
+    void PrintStats() const {
+        Stats stats = GetStats();
+        printf("Texture registry: %zu requests, %zu textures (%zu path hits, %zu content hits, %zu from baked files), "
+               "%.2f MB resident, %.2f MB saved, %zu requests hashed on the main thread\n", stats.requests,
+               stats.textures, stats.pathHits, stats.contentHits, TextureLoader::Instance().CompressedTextures(),
+               stats.residentBytes / 1048576.0, stats.savedBytes / 1048576.0, stats.contentChecks);
+    }
+
+private:
+    struct Entry {
+        unsigned int references = 0;
+        size_t sharedRequests = 0;
+        std::vector<std::string> paths; // as first requested, to hash the contents when the decode isn't done yet
+        bool flip = false;
+        std::string sizeKey;
+        uint64_t contentHash = 0; // 0 until it was needed for a comparison
+        std::vector<std::string> pathKeys;
+    };
+
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<std::string, std::vector<unsigned int>> bySize; // textures whose files have the same sizes
+    std::unordered_map<unsigned int, Entry> entries;
+    Stats counters;
+
+    TextureRegistry() = default;
+
+    template<typename LoadFunction>
+    unsigned int acquire(const std::vector<std::string> &paths, bool flip, LoadFunction load) {
+        counters.requests++;
+        // the same file loaded flipped and unflipped are two different textures
+        std::string pathKey = flip ? "1" : "0";
+        for (const std::string &path : paths)
+            pathKey += '|' + canonicalPath(path);
+
+        auto byPathFound = byPath.find(pathKey);
+        if (byPathFound != byPath.end()) {
+            counters.pathHits++;
+            return addReference(byPathFound->second);
+        }
+
+        // a texture is only shared once the hashes of the contents match, equal sizes just make it a candidate
+        std::string sizes = sizeKey(paths, flip);
+        uint64_t contentHash = 0;
+        auto sameSize = bySize.find(sizes);
+        if (!sizes.empty() && sameSize != bySize.end()) {
+            counters.contentChecks++;
+            contentHash = requestHash(paths, flip);
+            for (unsigned int candidate : sameSize->second) {
+                if (contentHash != 0 && loadedHash(candidate) == contentHash) {
+                    counters.contentHits++;
+                    byPath[pathKey] = candidate;
+                    entries[candidate].pathKeys.push_back(pathKey);
+                    return addReference(candidate);
+                }
+            }
+        }
+
+        unsigned int textureID = load();
+        Entry &entry = entries[textureID];
+        entry.references = 1;
+        entry.paths = paths;
+        entry.flip = flip;
+        entry.sizeKey = sizes;
+        entry.contentHash = contentHash;
+        entry.pathKeys.push_back(pathKey);
+        byPath[pathKey] = textureID;
+        if (!sizes.empty())
+            bySize[sizes].push_back(textureID);
+        return textureID;
+    }
+
+    unsigned int addReference(unsigned int textureID) {
+        Entry &entry = entries[textureID];
+        entry.references++;
+        entry.sharedRequests++;
+        return textureID;
+    }
+
+    static std::string canonicalPath(const std::string &path) {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+        return path;
+    }
+
+    // the hash of a loaded texture: known once its decode job is done, computed here from its files before that
+    uint64_t loadedHash(unsigned int textureID) {
+        Entry &entry = entries[textureID];
+        if (entry.contentHash == 0)
+            entry.contentHash = TextureLoader::Instance().ContentHash(textureID);
+        if (entry.contentHash == 0)
+            entry.contentHash = requestHash(entry.paths, entry.flip);
+        return entry.contentHash;
+    }
+
+    // a current baked file already knows the hash of its sources, otherwise they are read and hashed
+    static uint64_t requestHash(const std::vector<std::string> &paths, bool flip) {
+        KtxFile baked;
+        uint64_t hash = baked.OpenBaked(paths, flip) ? baked.StoredSourceHash() : 0;
+        return hash != 0 ? hash : KtxFile::SourceHash(paths, flip);
+    }
+
+    // the sizes of every file, packed assets answer from the pack index; empty when a file is missing, such
+    // requests are only deduplicated by path
+    static std::string sizeKey(const std::vector<std::string> &paths, bool flip) {
+        std::string key = flip ? "1" : "0";
+        for (const std::string &path : paths) {
+            size_t size;
+            int64_t modificationTime;
+            if (!AssetFileSystem::Instance().Stamp(path, size, modificationTime))
+                return std::string();
+            key += '|' + std::to_string(size);
+        }
+        return key;
+    }
+};
+
+#endif //PROJECT_BASE_TEXTUREREGISTRY_H
@@ -0,0 +1,121 @@
+#ifndef PROJECT_BASE_THREADPOOL_H
+#define PROJECT_BASE_THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads for CPU side loading work (parsing, decoding, mesh processing).
+// Jobs must not touch OpenGL, the context is only current on the main thread.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // pool shared by all loaders, sized to the number of hardware threads
+    static ThreadPool &Shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    unsigned int Size() const {
+        return (unsigned int) workers.size();
+    }
+
+    template<typename F>
+    auto Submit(F &&job) -> std::future<decltype(job())> {
+        typedef decltype(job()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push([task] { (*task)(); });
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+    // Runs job(i) for every i in [0, count) on the pool and on the calling thread, and returns once all are done.
+    // Safe to call from inside a pool job: the caller works through the items itself instead of blocking on helpers
+    // that may still be queued behind it, and helpers that start after the last item was taken return right away.
+    template<typename F>
+    void ParallelFor(size_t count, F job) {
+        struct State {
+            std::atomic<size_t> next{0};
+            size_t count = 0;
+            size_t active = 0;
+            std::mutex mutex;
+            std::condition_variable done;
+            std::function<void(size_t)> job;
+        };
+        auto state = std::make_shared<State>();
+        state->count = count;
+        state->job = job;
+        auto work = [state] {
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->active++;
+            }
+            for (size_t i = state->next++; i < state->count; i = state->next++)
+                state->job(i);
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->active--;
+            }
+            state->done.notify_all();
+        };
+
+        size_t helpers = std::min(count, (size_t) Size()) - (count > 0 ? 1 : 0);
+        for (size_t i = 0; i < helpers; i++)
+            Submit(work);
+        work();
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&state] { return state->active == 0; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    void workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+};
+
+#endif //PROJECT_BASE_THREADPOOL_H
@@ -0,0 +1,23 @@
+#ifndef PROJECT_BASE_TIMER_H
+#define PROJECT_BASE_TIMER_H
+
+#include <chrono>
+
+// wall clock stopwatch used for the startup and benchmark timings
+class Timer {
+public:
+    Timer() : start(std::chrono::steady_clock::now()) {}
+
+    void Reset() {
+        start = std::chrono::steady_clock::now();
+    }
+
+    double Milliseconds() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif //PROJECT_BASE_TIMER_H
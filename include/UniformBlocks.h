@@ -0,0 +1,160 @@
+#ifndef PROJECT_BASE_UNIFORMBLOCKS_H
+#define PROJECT_BASE_UNIFORMBLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+// Uniform blocks shared by every program: the camera of the frame and the lights of the scene. The structs mirror
+// the std140 layout of the blocks declared in the shaders, so a whole block is uploaded with one glBufferSubData.
+// In std140 a vec3 takes 16 bytes unless a scalar follows it, the light struct is declared in the shader with a
+// scalar after every vec3 for that reason and the remaining gaps are spelled out as padding here.
+//
+// GLSL 330 can't give a block its binding point, Shader::BindUniformBlock does it after the program is built.
+const unsigned int CAMERA_BLOCK_BINDING = 0;
+const unsigned int LIGHTS_BLOCK_BINDING = 1;
+const unsigned int CLUSTERS_BLOCK_BINDING = 2;
+const int MAX_LIGHTS = 16; // MAX_LIGHTS in advanced_lighting.fs
+
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 skyboxView; // view without the translation, the skybox is drawn around the camera
+    glm::vec3 viewPos;
+    float padding;
+};
+
+enum LightType {
+    LIGHT_DIRECTIONAL = 0,
+    LIGHT_POINT = 1,
+    LIGHT_SPOT = 2,
+};
+
+// one light of any type, the members its type doesn't use stay zero
+struct LightBlock {
+    glm::vec3 position;
+    int32_t type;
+    glm::vec3 direction;
+    float cutOff;      // cosines of the cone angles
+    glm::vec3 ambient;
+    float outerCutOff;
+    glm::vec3 diffuse;
+    float constant;
+    glm::vec3 specular;
+    float linear;
+    float quadratic;
+    float padding[3];
+};
+
+struct LightsBlock {
+    int32_t lightCount;
+    int32_t padding[3];
+    LightBlock lights[MAX_LIGHTS];
+
+    // false when the block is full
+    bool Add(const LightBlock &light) {
+        if (lightCount >= MAX_LIGHTS)
+            return false;
+        lights[lightCount++] = light;
+        return true;
+    }
+};
+
+// how LightClusters divided the view: fragments find their cluster with it, the lists themselves are in texture buffers
+struct ClustersBlock {
+    uint32_t size[3];      // tiles across, tiles down, depth slices
+    uint32_t globalLights; // the first lights of the light data, in every cluster without being listed
+    float sliceScale;      // slice = log(view depth) * sliceScale + sliceBias
+    float sliceBias;
+    float tileSize[2];     // in pixels
+};
+
+static_assert(sizeof(CameraBlock) == 208, "CameraBlock doesn't match the std140 layout of the Camera block");
+static_assert(sizeof(LightBlock) == 96, "LightBlock doesn't match the std140 layout of Light");
+static_assert(sizeof(LightsBlock) == 16 + MAX_LIGHTS * 96, "LightsBlock doesn't match the std140 layout of the Lights block");
+static_assert(sizeof(ClustersBlock) == 32, "ClustersBlock doesn't match the std140 layout of the Clusters block");
+
+LightBlock MakeDirectionalLight(glm::vec3 direction, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular) {
+    LightBlock light = {};
+    light.type = LIGHT_DIRECTIONAL;
+    light.direction = direction;
+    light.ambient = ambient;
+    light.diffuse = diffuse;
+    light.specular = specular;
+    return light;
+}
+
+// attenuated by 1 / (constant + linear * d + quadratic * d^2)
+LightBlock MakePointLight(glm::vec3 position, glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
+                          float constant, float linear, float quadratic) {
+    LightBlock light = {};
+    light.type = LIGHT_POINT;
+    light.position = position;
+    light.ambient = ambient;
+    light.diffuse = diffuse;
+    light.specular = specular;
+    light.constant = constant;
+    light.linear = linear;
+    light.quadratic = quadratic;
+    return light;
+}
+
+// a point light restricted to a cone, fading out between the two angles (in degrees)
+LightBlock MakeSpotLight(glm::vec3 position, glm::vec3 direction, float cutOffDegrees, float outerCutOffDegrees,
+                         glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular,
+                         float constant, float linear, float quadratic) {
+    LightBlock light = MakePointLight(position, ambient, diffuse, specular, constant, linear, quadratic);
+    light.type = LIGHT_SPOT;
+    light.direction = direction;
+    light.cutOff = glm::cos(glm::radians(cutOffDegrees));
+    light.outerCutOff = glm::cos(glm::radians(outerCutOffDegrees));
+    return light;
+}
+
+// A uniform buffer holding one block, bound to its binding point. Update() uploads the block only when it differs
+// from what the buffer already holds, a block that stays the same costs a memcmp per frame.
+template<typename Block>
+class UniformBuffer {
+public:
+    // with the GL context current
+    void Create(unsigned int binding) {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        valid = false;
+    }
+
+    void Destroy() {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+
+    // block has to be value initialized, the padding is compared as well
+    void Update(const Block &block) {
+        if (valid && memcmp(&uploaded, &block, sizeof(Block)) == 0)
+            return;
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        uploaded = block;
+        valid = true;
+        uploads++;
+    }
+
+    // glBufferSubData calls so far
+    size_t Uploads() const {
+        return uploads;
+    }
+
+private:
+    unsigned int buffer = 0;
+    Block uploaded;
+    bool valid = false;
+    size_t uploads = 0;
+};
+
+#endif //PROJECT_BASE_UNIFORMBLOCKS_H
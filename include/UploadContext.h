@@ -0,0 +1,168 @@
+#ifndef PROJECT_BASE_UPLOADCONTEXT_H
+#define PROJECT_BASE_UPLOADCONTEXT_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Second OpenGL context for creating buffers and textures off the main thread. Start() opens a hidden window
+// whose context shares objects with the main window and hands it to a loader thread. Submit() queues work for that
+// thread; after each piece of work it places a fence, and Poll() on the main thread runs the matching done
+// callback once the fence has signaled, so the main context only ever sees finished objects.
+//
+// Container objects (vertex arrays, framebuffers) aren't shared between contexts, done callbacks create those on
+// the main context. Objects whose parameters the renderer depends on, like a texture's base level, are also
+// changed there, after the data they describe is complete.
+//
+// While it isn't running, Submit() runs the work and the done callback right away on the calling thread.
+class UploadContext {
+public:
+    static UploadContext &Instance() {
+        static UploadContext context;
+        return context;
+    }
+
+    static bool &Enabled() {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    // on the main thread with the main context current; false when the shared context can't be created
+    bool Start(GLFWwindow *mainWindow) {
+        if (running || !Enabled())
+            return running;
+        // the context version and profile hints of the main window are still set
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(1, 1, "upload", NULL, mainWindow);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (!window)
+            return false;
+        stopping = false;
+        running = true;
+        thread = std::thread([this] { threadLoop(); });
+        return true;
+    }
+
+    // finishes the queued work and destroys the context; on the main thread, before glfwTerminate
+    void Stop() {
+        if (!running)
+            return;
+        Finish();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        thread.join();
+        glfwDestroyWindow(window);
+        window = nullptr;
+        running = false;
+    }
+
+    bool Running() const {
+        return running;
+    }
+
+    // work runs on the loader thread with the shared context current, done on the main thread once the GL commands
+    // issued by work have completed
+    void Submit(std::function<void()> work, std::function<void()> done) {
+        if (!running) {
+            work();
+            done();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(Job{std::move(work), std::move(done), nullptr});
+            submitted++;
+        }
+        wakeUp.notify_all();
+    }
+
+    // runs the done callbacks of the finished work, in submission order; on the main thread once per frame
+    void Poll() {
+        while (true) {
+            Job job;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (finished.empty())
+                    return;
+                GLenum status = glClientWaitSync(finished.front().fence, 0, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                    return;
+                job = std::move(finished.front());
+                finished.pop_front();
+            }
+            glDeleteSync(job.fence);
+            job.done();
+            completed++;
+        }
+    }
+
+    // blocks until everything submitted so far is done and its callbacks have run
+    void Finish() {
+        while (completed < submitted) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobDone.wait(lock, [this] { return !finished.empty(); });
+                glClientWaitSync(finished.front().fence, 0, GL_TIMEOUT_IGNORED);
+            }
+            Poll();
+        }
+    }
+
+    // work submitted and not yet handed back through Poll
+    size_t Pending() const {
+        return submitted - completed;
+    }
+
+private:
+    struct Job {
+        std::function<void()> work, done;
+        GLsync fence;
+    };
+
+    GLFWwindow *window = nullptr;
+    std::thread thread;
+    bool running = false;
+    std::mutex mutex;
+    std::condition_variable wakeUp, jobDone;
+    std::deque<Job> queued, finished;
+    bool stopping = false;
+    size_t submitted = 0, completed = 0; // main thread only
+
+    UploadContext() = default;
+
+    void threadLoop() {
+        glfwMakeContextCurrent(window);
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !queued.empty(); });
+                if (queued.empty())
+                    break;
+                job = std::move(queued.front());
+                queued.pop_front();
+            }
+            job.work();
+            job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            // the fence has to reach the GPU before the main context can see it signal
+            glFlush();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back(std::move(job));
+            }
+            jobDone.notify_all();
+        }
+        glfwMakeContextCurrent(NULL);
+    }
+};
+
+#endif //PROJECT_BASE_UPLOADCONTEXT_H
@@ -7,6 +7,11 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
+#include <cerrno>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 std::string readFileContents(std::string path) {
     std::ifstream in(path);
@@ -15,5 +20,67 @@ std::string readFileContents(std::string path) {
     return buffer.str();
 }
 
+// 64-bit FNV-1a, stable across runs and compilers so it can be used to name files on disk
+uint64_t fnv1a64(const void *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t fnv1a64(const std::string &text, uint64_t hash = 14695981039346656037ull) {
+    return fnv1a64(text.data(), text.size(), hash);
+}
+
+// creates every missing directory on the path (mkdir -p)
+bool makeDirectories(const std::string &path) {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+        std::string prefix = path.substr(0, pos);
+        if (!prefix.empty() && mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+        if (pos == std::string::npos)
+            return true;
+    }
+}
+
+// resident set size of the process right now, 0 where /proc is not available
+size_t currentResidentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    if (!(statm >> totalPages >> residentPages))
+        return 0;
+    return residentPages * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+// largest resident set size the process has had so far
+size_t peakResidentBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (size_t) usage.ru_maxrss * 1024; // kilobytes on Linux
+}
+
+// read system calls the process has made so far and the bytes they returned, zero where /proc is not available.
+// Reads from memory mappings don't show up here, they are page faults.
+struct ProcessReads {
+    size_t calls = 0;
+    size_t bytes = 0;
+};
+
+ProcessReads currentProcessReads() {
+    std::ifstream io("/proc/self/io");
+    ProcessReads reads;
+    std::string key;
+    size_t value;
+    while (io >> key >> value) {
+        if (key == "rchar:")
+            reads.bytes = value;
+        else if (key == "syscr:")
+            reads.calls = value;
+    }
+    return reads;
+}
 
 #endif //PROJECT_BASE_COMMON_H
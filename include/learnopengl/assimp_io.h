@@ -0,0 +1,95 @@
+#ifndef ASSIMP_IO_H
+#define ASSIMP_IO_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <AssetFileSystem.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+// Assimp reads every file through these instead of opening it itself, so models and their material libraries come
+// out of the resource pack like every other asset. Assimp wants the bytes in its own buffers, the copies made by
+// Read are counted by AssetFileSystem.
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+    explicit AssetIOStream(AssetFile &&file) : file(std::move(file)) {}
+
+    size_t Read(void *buffer, size_t size, size_t count) override
+    {
+        if(size == 0)
+            return 0;
+        size_t items = std::min(count, (file.size() - position) / size);
+        memcpy(buffer, file.data() + position, items * size);
+        position += items * size;
+        AssetFileSystem::Instance().CountCopy(items * size);
+        return items;
+    }
+
+    size_t Write(const void *buffer, size_t size, size_t count) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? position : file.size();
+        if(base + offset > file.size())
+            return aiReturn_FAILURE;
+        position = base + offset;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return position;
+    }
+
+    size_t FileSize() const override
+    {
+        return file.size();
+    }
+
+    void Flush() override
+    {
+    }
+
+private:
+    AssetFile file;
+    size_t position = 0;
+};
+
+// read only, writing through it fails
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char *path) const override
+    {
+        return AssetFileSystem::Instance().Exists(path);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream *Open(const char *path, const char *mode = "rb") override
+    {
+        if(strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+            return nullptr;
+        AssetFile file(path);
+        if(!file.isOpen())
+            return nullptr;
+        return new AssetIOStream(std::move(file));
+    }
+
+    void Close(Assimp::IOStream *stream) override
+    {
+        delete stream;
+    }
+};
+
+#endif
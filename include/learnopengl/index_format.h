@@ -0,0 +1,94 @@
+#ifndef INDEX_FORMAT_H
+#define INDEX_FORMAT_H
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+// meshes whose 16-bit batches would average fewer triangles than this stay 32-bit, more draw calls would cost more
+// than the index bandwidth saves
+const size_t INDEX_BATCH_MIN_TRIANGLES = 1024;
+
+// Chooses the index width of a mesh. Meshes with at most 65536 vertices get 16-bit indices. Larger meshes are split
+// into batches of consecutive triangles whose vertices fit into a 65536 wide window of the vertex buffer; a batch
+// stores its indices relative to the start of the window and is drawn with glDrawElementsBaseVertex, so the mesh
+// keeps a single vertex and index buffer. Vertex fetch ordering (mesh_optimizer.h) keeps those windows long.
+void PackIndices(MeshData &mesh)
+{
+    mesh.indexType = GL_UNSIGNED_INT;
+    mesh.shortIndices.clear();
+    mesh.batches.clear();
+    if(mesh.lods.empty())
+    {
+        mesh.lods.push_back(MeshLod());
+        mesh.lods[0].indexCount = (unsigned int) mesh.indices.size();
+    }
+
+    // every level is cut into batches on its own, a batch never spans two levels
+    const vector<unsigned int> &indices = mesh.indices;
+    vector<IndexBatch> batches;
+    vector<MeshLod> lods = mesh.lods;
+    // false once a single triangle spans more than a 16-bit window, such a mesh can't be split at all
+    bool splittable = true;
+    for(MeshLod &lod : lods)
+    {
+        lod.firstBatch = (unsigned int) batches.size();
+        size_t end = (size_t) lod.indexOffset + lod.indexCount;
+        size_t begin = lod.indexOffset;
+        while(splittable && begin < end)
+        {
+            unsigned int low = indices[begin], high = indices[begin];
+            size_t cursor = begin;
+            for(; cursor < end; cursor += 3)
+            {
+                unsigned int triangleLow = std::min(indices[cursor], std::min(indices[cursor + 1], indices[cursor + 2]));
+                unsigned int triangleHigh = std::max(indices[cursor], std::max(indices[cursor + 1], indices[cursor + 2]));
+                if(std::max(high, triangleHigh) - std::min(low, triangleLow) > 0xffffu)
+                {
+                    splittable = cursor > begin;
+                    break;
+                }
+                low = std::min(low, triangleLow);
+                high = std::max(high, triangleHigh);
+            }
+            if(!splittable)
+                break;
+            IndexBatch batch;
+            batch.indexOffset = (unsigned int) begin;
+            batch.indexCount = (unsigned int) (cursor - begin);
+            batch.baseVertex = (int) low;
+            batches.push_back(batch);
+            begin = cursor;
+        }
+        lod.batchCount = (unsigned int) batches.size() - lod.firstBatch;
+    }
+
+    bool split = batches.size() > lods.size();
+    if(!splittable || (split && indices.size() / 3 / batches.size() < INDEX_BATCH_MIN_TRIANGLES))
+    {
+        // too fragmented or not splittable, one 32-bit batch per level
+        for(MeshLod &lod : lods)
+        {
+            lod.firstBatch = (unsigned int) mesh.batches.size();
+            lod.batchCount = 1;
+            IndexBatch batch;
+            batch.indexOffset = lod.indexOffset;
+            batch.indexCount = lod.indexCount;
+            mesh.batches.push_back(batch);
+        }
+        mesh.lods = lods;
+        return;
+    }
+
+    mesh.indexType = GL_UNSIGNED_SHORT;
+    mesh.shortIndices.resize(indices.size());
+    for(const IndexBatch &batch : batches)
+        for(size_t i = batch.indexOffset; i < (size_t) batch.indexOffset + batch.indexCount; i++)
+            mesh.shortIndices[i] = (uint16_t) (indices[i] - (unsigned int) batch.baseVertex);
+    mesh.batches = batches;
+    mesh.lods = lods;
+}
+#endif
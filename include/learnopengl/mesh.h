@@ -7,7 +7,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <UploadContext.h>
 
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
 #include <vector>
 using namespace std;
@@ -25,7 +29,85 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// GPU side vertex layouts. The packed layouts are built at import time from the float Vertex:
+// normals and tangents as snorm 10-10-10-2 (the tangent's w holds the bitangent sign, the bitangent
+// itself is reconstructed as cross(normal, tangent) * w), texture coordinates as half floats and,
+// optionally, positions as unorm16 relative to the mesh bounds.
+enum VertexFormat {
+    VERTEX_FORMAT_FLOAT,               // Vertex, 56 bytes
+    VERTEX_FORMAT_PACKED,              // PackedVertex, 24 bytes
+    VERTEX_FORMAT_PACKED_POSITIONS16   // PackedVertexPositions16, 20 bytes
+};
 
+struct PackedVertex {
+    glm::vec3 Position;
+    uint32_t  Normal;
+    uint32_t  Tangent;
+    uint16_t  TexCoords[2];
+};
+
+struct PackedVertexPositions16 {
+    uint16_t Position[4]; // w is padding
+    uint32_t Normal;
+    uint32_t Tangent;
+    uint16_t TexCoords[2];
+};
+
+size_t VertexStride(VertexFormat format)
+{
+    if(format == VERTEX_FORMAT_PACKED)
+        return sizeof(PackedVertex);
+    if(format == VERTEX_FORMAT_PACKED_POSITIONS16)
+        return sizeof(PackedVertexPositions16);
+    return sizeof(Vertex);
+}
+
+// maps unorm16 positions back to object space: position = offset + scale * stored
+struct PositionQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// vertex cache efficiency of a mesh before and after the import time reordering (see mesh_optimizer.h) and the
+// vertex count before and after welding (see mesh_welder.h)
+struct MeshOptimizationStats {
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+    unsigned int verticesBeforeWeld = 0; // both 0 when the mesh wasn't welded
+    unsigned int verticesAfterWeld = 0;
+};
+
+// levels of detail share the vertex buffer, each one is a range of the index buffer.
+// Level 0 is the full mesh, error estimates how far the level deviates from it in object space units: the quadric
+// error of the simplification, a root mean square plane distance rather than a bound on the largest deviation.
+const unsigned int MESH_MAX_LODS = 4;
+
+struct MeshLod {
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;
+    unsigned int firstBatch = 0; // the draw batches covering the range, see IndexBatch
+    unsigned int batchCount = 0;
+};
+
+// a draw call over a range of the index buffer; 16-bit indices are stored relative to baseVertex
+struct IndexBatch {
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    int baseVertex = 0;
+};
+
+size_t IndexSize(GLenum indexType)
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+}
+
+// what a Mesh keeps of its geometry on the CPU once it is uploaded
+enum CpuGeometry {
+    CPU_GEOMETRY_KEEP,      // vertices and indices as imported
+    CPU_GEOMETRY_POSITIONS, // positions and the 32-bit indices of the full level, enough for picking
+    CPU_GEOMETRY_RELEASE    // nothing, the GPU buffers are the only copy
+};
 
 struct Texture {
     unsigned int id;
@@ -33,88 +115,326 @@ struct Texture {
     string path;
 };
 
+// CPU side data of a mesh before it is uploaded, produced by the import without touching OpenGL.
+// The geometry is either owned by the vectors or, for meshes read from the mesh cache, points into
+// a mapped file that has to stay alive until the mesh is uploaded. For packed formats the GPU layout
+// lives in packedVertices next to the float vertices it was built from.
+struct MeshData {
+    vector<Vertex>        vertices;
+    vector<unsigned int>  indices;
+    vector<Texture>       textures; // only type and path are known, the textures are loaded on the GL thread
+    VertexFormat          format = VERTEX_FORMAT_FLOAT;
+    vector<unsigned char> packedVertices;
+    PositionQuantization  quantization;
+    MeshOptimizationStats optimization;
+    vector<MeshLod>       lods;         // empty means a single level covering all indices
+    GLenum                indexType = GL_UNSIGNED_INT;
+    vector<uint16_t>      shortIndices; // the index buffer for GL_UNSIGNED_SHORT, built from indices
+    vector<IndexBatch>    batches;
+    glm::vec3             boundsCenter = glm::vec3(0.0f);
+    float                 boundsRadius = 0.0f;
+
+    const void         *mappedVertices = nullptr;
+    const void         *mappedIndices = nullptr;
+    size_t mappedVertexCount = 0;
+    size_t mappedIndexCount = 0;
+
+    // vertex data in the GPU layout of format
+    const void *VertexData() const
+    {
+        if(mappedVertices)
+            return mappedVertices;
+        if(format != VERTEX_FORMAT_FLOAT)
+            return packedVertices.data();
+        return vertices.data();
+    }
+    // index data in the width of indexType
+    const void *IndexData() const
+    {
+        if(mappedIndices)
+            return mappedIndices;
+        if(indexType == GL_UNSIGNED_SHORT)
+            return shortIndices.data();
+        return indices.data();
+    }
+    size_t VertexCount() const
+    {
+        if(mappedVertices)
+            return mappedVertexCount;
+        if(format != VERTEX_FORMAT_FLOAT)
+            return packedVertices.size() / VertexStride(format);
+        return vertices.size();
+    }
+    size_t IndexCount() const { return mappedIndices ? mappedIndexCount : indices.size(); }
+};
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    vector<glm::vec3>    positions; // only filled with CPU_GEOMETRY_POSITIONS
 
-    unsigned int VAO;
+    unsigned int VAO = 0;
+    unsigned int indexCount;
+    VertexFormat format = VERTEX_FORMAT_FLOAT;
+    PositionQuantization quantization;
+    vector<MeshLod> lods;
+    vector<IndexBatch> batches;
+    GLenum indexType = GL_UNSIGNED_INT;
+    unsigned int currentLod = 0; // level drawn by Draw, chosen by Model::SelectLod
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    // bytes of the vertex buffer on the GPU, and what the same vertices take in the float layout
+    size_t vertexBytes = 0;
+    size_t floatVertexBytes = 0;
+    size_t indexBytes = 0;
     std::string glslIdentifierPrefix;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+    }
+
+    // constructs the mesh from imported data in any vertex format, taking over its arrays. Geometry that lives in
+    // a mapped mesh cache is uploaded straight from the mapping and vertices and indices stay empty on the CPU side.
+    // The buffers are filled through the UploadContext, until they are the mesh isn't Ready and Draw skips it.
+    Mesh(MeshData &&data, vector<Texture> textures, CpuGeometry cpuGeometry = CPU_GEOMETRY_KEEP)
+    {
+        this->textures = std::move(textures);
+        this->format = data.format;
+        this->quantization = data.quantization;
+        this->lods = std::move(data.lods);
+        this->batches = std::move(data.batches);
+        this->indexType = data.indexType;
+        this->boundsCenter = data.boundsCenter;
+        this->boundsRadius = data.boundsRadius;
+
+        setupSizes(data.VertexCount(), data.IndexCount());
+
+        // the upload reads the arrays on the loader thread, what the mesh keeps of them is taken once it is done
+        shared_ptr<PendingUpload> upload = make_shared<PendingUpload>();
+        upload->data = make_shared<MeshData>(std::move(data));
+        upload->cpuGeometry = cpuGeometry;
+        pending = upload;
+        size_t vertexBytes = this->vertexBytes, indexBytes = this->indexBytes;
+        UploadContext::Instance().Submit([upload, vertexBytes, indexBytes]()
+        {
+            createBuffers(upload->VBO, upload->EBO, upload->data->VertexData(), vertexBytes, upload->data->IndexData(), indexBytes);
+        }, [upload]()
+        {
+            upload->uploaded = true;
+        });
+        Ready();
+    }
+
+    // true once the buffers are filled; creates the vertex array on the first call after that, so it has to be called
+    // on the main context
+    bool Ready()
+    {
+        if(!pending)
+            return true;
+        if(!pending->uploaded)
+            return false;
+        VBO = pending->VBO;
+        EBO = pending->EBO;
+        createVertexArray();
+
+        MeshData &data = *pending->data;
+        if(pending->cpuGeometry == CPU_GEOMETRY_KEEP)
+        {
+            this->vertices = std::move(data.vertices);
+            this->indices = std::move(data.indices);
+        }
+        else if(pending->cpuGeometry == CPU_GEOMETRY_POSITIONS)
+            keepPositions(data);
+        // the packed copies are never needed after the upload
+        pending.reset();
+        return true;
+    }
+
+    // bytes of geometry this mesh keeps on the CPU
+    size_t CpuBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) +
+               positions.capacity() * sizeof(glm::vec3);
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
+        if(!Ready())
+            return;
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
+        const UniformLocations &uniforms = uniformLocations(shader);
         for(unsigned int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
+            shader.setInt(uniforms.samplers[i], i);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
 
 
 
+        // 16-bit positions are decoded in the vertex shader
+        bool quantizedPosition = format == VERTEX_FORMAT_PACKED_POSITIONS16;
+        if(quantizedPosition)
+        {
+            shader.setBool(uniforms.quantizedPosition, true);
+            shader.setVec3(uniforms.positionOffset, quantization.offset);
+            shader.setVec3(uniforms.positionScale, quantization.scale);
+        }
+
         // draw mesh
+        const MeshLod &lod = lods[currentLod];
+        size_t indexSize = IndexSize(indexType);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        for(unsigned int i = lod.firstBatch; i < lod.firstBatch + lod.batchCount; i++)
+            glDrawElementsBaseVertex(GL_TRIANGLES, batches[i].indexCount, indexType,
+                                     (void*)(batches[i].indexOffset * indexSize), batches[i].baseVertex);
         glBindVertexArray(0);
 
+        if(quantizedPosition)
+            shader.setBool(uniforms.quantizedPosition, false);
+
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+
+    // geometry on its way to the GPU, shared with the upload work until it is done
+    struct PendingUpload
+    {
+        shared_ptr<MeshData> data;
+        CpuGeometry cpuGeometry = CPU_GEOMETRY_KEEP;
+        unsigned int VBO = 0, EBO = 0;
+        bool uploaded = false; // set on the main thread once the buffers are complete
+    };
+    shared_ptr<PendingUpload> pending;
+
+    // what Draw sets, resolved for the program it was last drawn with
+    struct UniformLocations
+    {
+        unsigned int program = 0;
+        std::string prefix;
+        vector<int> samplers; // per texture
+        int quantizedPosition = -1, positionOffset = -1, positionScale = -1;
+    };
+    UniformLocations uniforms;
+
+    // the sampler of the Nth texture of a type is named glslIdentifierPrefix + type + N, diffuse_texture1 and on
+    const UniformLocations &uniformLocations(const Shader &shader)
+    {
+        if(uniforms.program == shader.ID && uniforms.prefix == glslIdentifierPrefix &&
+           uniforms.samplers.size() == textures.size() && Shader::CacheUniformLocations())
+            return uniforms;
+        uniforms.program = shader.ID;
+        uniforms.prefix = glslIdentifierPrefix;
+        uniforms.samplers.clear();
+        unsigned int diffuseNr  = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr   = 1;
+        unsigned int heightNr   = 1;
+        for(const Texture &texture : textures)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            string number;
+            const string &name = texture.type;
+            if(name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if(name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to stream
+            else if(name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to stream
+            else if(name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to stream
+            uniforms.samplers.push_back(shader.Location(glslIdentifierPrefix + name + number));
+        }
+        uniforms.quantizedPosition = shader.Location("quantizedPosition");
+        uniforms.positionOffset = shader.Location("positionOffset");
+        uniforms.positionScale = shader.Location("positionScale");
+        return uniforms;
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const void *vertexData, size_t vertexCount, const void *indexData, size_t indexCount)
+    {
+        setupSizes(vertexCount, indexCount);
+        createBuffers(VBO, EBO, vertexData, vertexBytes, indexData, indexBytes);
+        createVertexArray();
+    }
+
+    // the default level and draw batches, and the buffer sizes
+    void setupSizes(size_t vertexCount, size_t indexCount)
+    {
+        this->indexCount = indexCount;
+        if(lods.empty())
+        {
+            lods.push_back(MeshLod());
+            lods[0].indexCount = indexCount;
+        }
+        // without batches every level is drawn with one call
+        if(batches.empty())
+        {
+            for(MeshLod &lod : lods)
+            {
+                IndexBatch batch;
+                batch.indexOffset = lod.indexOffset;
+                batch.indexCount = lod.indexCount;
+                lod.firstBatch = (unsigned int) batches.size();
+                lod.batchCount = 1;
+                batches.push_back(batch);
+            }
+        }
+        indexBytes = indexCount * IndexSize(indexType);
+        vertexBytes = vertexCount * VertexStride(format);
+        floatVertexBytes = vertexCount * sizeof(Vertex);
+    }
+
+    // buffers are shared between contexts, so this may run on the loader thread
+    static void createBuffers(unsigned int &VBO, unsigned int &EBO, const void *vertexData, size_t vertexBytes,
+                              const void *indexData, size_t indexBytes)
     {
-        // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
-
-        glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indexData, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
 
+    // vertex arrays aren't shared between contexts, this runs on the main one
+    void createVertexArray()
+    {
+        glGenVertexArrays(1, &VAO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+
+        if(format != VERTEX_FORMAT_FLOAT)
+        {
+            setupPackedAttributes();
+            glBindVertexArray(0);
+            return;
+        }
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -135,5 +455,74 @@ private:
 
         glBindVertexArray(0);
     }
+
+    // decodes the positions from the uploaded vertex layout and expands the full level's indices to 32 bits
+    void keepPositions(const MeshData &data)
+    {
+        const unsigned char *vertexData = static_cast<const unsigned char *>(data.VertexData());
+        size_t stride = VertexStride(format);
+        positions.resize(data.VertexCount());
+        for(size_t i = 0; i < positions.size(); i++)
+        {
+            const unsigned char *vertex = vertexData + i * stride;
+            if(format == VERTEX_FORMAT_PACKED_POSITIONS16)
+            {
+                uint16_t stored[3];
+                memcpy(stored, vertex + offsetof(PackedVertexPositions16, Position), sizeof(stored));
+                positions[i] = quantization.offset + quantization.scale * glm::vec3(stored[0], stored[1], stored[2]) / 65535.0f;
+            }
+            else
+                memcpy(&positions[i], vertex, sizeof(glm::vec3)); // Position is the first member of both other layouts
+        }
+
+        const MeshLod &lod = lods[0];
+        indices.resize(lod.indexCount);
+        for(unsigned int b = lod.firstBatch; b < lod.firstBatch + lod.batchCount; b++)
+        {
+            const IndexBatch &batch = batches[b];
+            for(unsigned int i = batch.indexOffset; i < batch.indexOffset + batch.indexCount; i++)
+            {
+                unsigned int index;
+                if(indexType == GL_UNSIGNED_SHORT)
+                    index = static_cast<const uint16_t *>(data.IndexData())[i];
+                else
+                    index = static_cast<const unsigned int *>(data.IndexData())[i];
+                indices[i - lod.indexOffset] = index + batch.baseVertex;
+            }
+        }
+    }
+
+    // attribute pointers of the packed layouts; location 4 (bitangent) stays disabled, it is derived from the tangent
+    void setupPackedAttributes()
+    {
+        // both packed layouts share everything after the position
+        GLsizei stride = (GLsizei) VertexStride(format);
+        size_t normalOffset, tangentOffset, texCoordsOffset;
+        if(format == VERTEX_FORMAT_PACKED_POSITIONS16)
+        {
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(PackedVertexPositions16, Position));
+            normalOffset = offsetof(PackedVertexPositions16, Normal);
+            tangentOffset = offsetof(PackedVertexPositions16, Tangent);
+            texCoordsOffset = offsetof(PackedVertexPositions16, TexCoords);
+        }
+        else
+        {
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedVertex, Position));
+            normalOffset = offsetof(PackedVertex, Normal);
+            tangentOffset = offsetof(PackedVertex, Tangent);
+            texCoordsOffset = offsetof(PackedVertex, TexCoords);
+        }
+        // vertex normals
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)normalOffset);
+        // vertex texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)texCoordsOffset);
+        // vertex tangent, w is the bitangent sign
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)tangentOffset);
+    }
 };
 #endif
\ No newline at end of file
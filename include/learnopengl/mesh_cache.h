@@ -0,0 +1,325 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <AssetFileSystem.h>
+#include <common.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// Binary cache of the processed meshes of a model, so repeated launches can skip Assimp entirely.
+// A cache file is keyed by the source path, its modification time/size, the Assimp import flags and a key of the
+// remaining import options (vertex format, whether the native OBJ loader read it, ...) it was built with; when any
+// of those differ, or the format version changes, the cache is treated as stale and rebuilt.
+//
+// File layout:
+//   MeshCacheHeader
+//   source path (sourcePathLength bytes)
+//   MeshCacheEntry[meshCount]
+//   texture records: { uint32 typeLength, uint32 pathLength, type chars, path chars }
+//   per mesh: vertex payload in its GPU layout, index payload in its index width and the IndexBatch table,
+//   each aligned to MESH_CACHE_ALIGNMENT bytes
+const uint32_t MESH_CACHE_VERSION = 6;
+const uint64_t MESH_CACHE_ALIGNMENT = 16;
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t vertexStride;
+    uint64_t optionsKey;
+    int64_t sourceMtime;
+    uint64_t sourceSize;
+    uint32_t sourcePathLength;
+    uint32_t meshCount;
+};
+
+struct MeshCacheEntry {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureOffset;
+    uint32_t textureCount;
+    uint32_t vertexFormat;
+    float positionOffset[3];
+    float positionScale[3];
+    float acmrBefore;
+    float acmrAfter;
+    uint32_t verticesBeforeWeld;
+    uint32_t verticesAfterWeld;
+    float boundsCenter[3];
+    float boundsRadius;
+    uint32_t lodCount;
+    uint32_t lodIndexOffset[MESH_MAX_LODS];
+    uint32_t lodIndexCount[MESH_MAX_LODS];
+    float lodError[MESH_MAX_LODS];
+    uint32_t lodFirstBatch[MESH_MAX_LODS];
+    uint32_t lodBatchCount[MESH_MAX_LODS];
+    uint32_t indexType;
+    uint32_t batchCount;
+    uint64_t batchOffset;
+};
+
+class MeshCache {
+public:
+    // directory the cache files are written to, relative to the working directory like the model paths
+    static string &Directory()
+    {
+        static string directory = "resources/cache/meshes";
+        return directory;
+    }
+
+    static bool &Enabled()
+    {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    static string CachePath(const string &sourcePath)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.rgmesh", (unsigned long long) fnv1a64(sourcePath));
+        return Directory() + '/' + name;
+    }
+
+    static void Invalidate(const string &sourcePath)
+    {
+        unlink(CachePath(sourcePath).c_str());
+    }
+
+    // maps the cache file of the given source and validates it, returns false if it is missing or stale
+    bool Open(const string &sourcePath, unsigned int importFlags, uint64_t optionsKey)
+    {
+        meshes.clear();
+        int64_t mtime;
+        uint64_t size;
+        if (!statSource(sourcePath, mtime, size) || !file.open(CachePath(sourcePath)))
+            return false;
+
+        const unsigned char *base = file.data();
+        if (file.size() < sizeof(MeshCacheHeader))
+            return fail();
+        MeshCacheHeader header;
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, "RGMC", 4) != 0 || header.version != MESH_CACHE_VERSION ||
+            header.importFlags != importFlags || header.vertexStride != sizeof(Vertex) || header.optionsKey != optionsKey ||
+            header.sourceMtime != mtime || header.sourceSize != size)
+            return fail();
+
+        uint64_t offset = sizeof(MeshCacheHeader);
+        if (offset + header.sourcePathLength > file.size() ||
+            sourcePath.compare(0, string::npos, (const char *) base + offset, header.sourcePathLength) != 0)
+            return fail();
+        offset += header.sourcePathLength;
+
+        if (offset + (uint64_t) header.meshCount * sizeof(MeshCacheEntry) > file.size())
+            return fail();
+        for (uint32_t i = 0; i < header.meshCount; i++) {
+            MeshCacheEntry entry;
+            memcpy(&entry, base + offset + i * sizeof(MeshCacheEntry), sizeof(entry));
+            if (entry.vertexFormat > VERTEX_FORMAT_PACKED_POSITIONS16 ||
+                entry.vertexOffset + (uint64_t) entry.vertexCount * VertexStride((VertexFormat) entry.vertexFormat) > file.size() ||
+                (entry.indexType != GL_UNSIGNED_INT && entry.indexType != GL_UNSIGNED_SHORT) ||
+                entry.indexOffset + (uint64_t) entry.indexCount * IndexSize(entry.indexType) > file.size() ||
+                entry.batchOffset + (uint64_t) entry.batchCount * sizeof(IndexBatch) > file.size() ||
+                entry.lodCount > MESH_MAX_LODS)
+                return fail();
+
+            // the mesh data points into the mapping, which stays valid while this MeshCache is alive
+            MeshData mesh;
+            mesh.format = (VertexFormat) entry.vertexFormat;
+            mesh.quantization.offset = glm::vec3(entry.positionOffset[0], entry.positionOffset[1], entry.positionOffset[2]);
+            mesh.quantization.scale = glm::vec3(entry.positionScale[0], entry.positionScale[1], entry.positionScale[2]);
+            mesh.optimization.acmrBefore = entry.acmrBefore;
+            mesh.optimization.acmrAfter = entry.acmrAfter;
+            mesh.optimization.verticesBeforeWeld = entry.verticesBeforeWeld;
+            mesh.optimization.verticesAfterWeld = entry.verticesAfterWeld;
+            mesh.boundsCenter = glm::vec3(entry.boundsCenter[0], entry.boundsCenter[1], entry.boundsCenter[2]);
+            mesh.boundsRadius = entry.boundsRadius;
+            for (uint32_t lod = 0; lod < entry.lodCount; lod++) {
+                if ((uint64_t) entry.lodIndexOffset[lod] + entry.lodIndexCount[lod] > entry.indexCount ||
+                    (uint64_t) entry.lodFirstBatch[lod] + entry.lodBatchCount[lod] > entry.batchCount)
+                    return fail();
+                MeshLod meshLod;
+                meshLod.indexOffset = entry.lodIndexOffset[lod];
+                meshLod.indexCount = entry.lodIndexCount[lod];
+                meshLod.error = entry.lodError[lod];
+                meshLod.firstBatch = entry.lodFirstBatch[lod];
+                meshLod.batchCount = entry.lodBatchCount[lod];
+                mesh.lods.push_back(meshLod);
+            }
+            mesh.indexType = entry.indexType;
+            mesh.batches.resize(entry.batchCount);
+            memcpy(mesh.batches.data(), base + entry.batchOffset, entry.batchCount * sizeof(IndexBatch));
+            for (const IndexBatch &batch : mesh.batches)
+                if ((uint64_t) batch.indexOffset + batch.indexCount > entry.indexCount)
+                    return fail();
+            mesh.mappedVertices = base + entry.vertexOffset;
+            mesh.mappedVertexCount = entry.vertexCount;
+            mesh.mappedIndices = base + entry.indexOffset;
+            mesh.mappedIndexCount = entry.indexCount;
+            if (!readTextures(entry, mesh.textures))
+                return fail();
+            meshes.push_back(std::move(mesh));
+        }
+        return true;
+    }
+
+    vector<MeshData> &Meshes()
+    {
+        return meshes;
+    }
+
+    // writes the processed meshes of a model
+    static bool Write(const string &sourcePath, unsigned int importFlags, uint64_t optionsKey, const vector<MeshData> &meshes)
+    {
+        MeshCacheHeader header;
+        memcpy(header.magic, "RGMC", 4);
+        header.version = MESH_CACHE_VERSION;
+        header.importFlags = importFlags;
+        header.vertexStride = sizeof(Vertex);
+        header.optionsKey = optionsKey;
+        header.sourcePathLength = (uint32_t) sourcePath.size();
+        header.meshCount = (uint32_t) meshes.size();
+        if (!statSource(sourcePath, header.sourceMtime, header.sourceSize))
+            return false;
+
+        // texture records go right after the entry table, payloads after that
+        string textureRecords;
+        vector<MeshCacheEntry> entries(meshes.size());
+        uint64_t tableEnd = sizeof(MeshCacheHeader) + sourcePath.size() + meshes.size() * sizeof(MeshCacheEntry);
+        for (size_t i = 0; i < meshes.size(); i++) {
+            entries[i].textureOffset = (uint32_t) (tableEnd + textureRecords.size());
+            entries[i].textureCount = (uint32_t) meshes[i].textures.size();
+            for (const Texture &texture : meshes[i].textures) {
+                uint32_t lengths[2] = {(uint32_t) texture.type.size(), (uint32_t) texture.path.size()};
+                textureRecords.append((const char *) lengths, sizeof(lengths));
+                textureRecords += texture.type;
+                textureRecords += texture.path;
+            }
+        }
+        uint64_t offset = align(tableEnd + textureRecords.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            entries[i].vertexFormat = meshes[i].format;
+            for (int c = 0; c < 3; c++) {
+                entries[i].positionOffset[c] = meshes[i].quantization.offset[c];
+                entries[i].positionScale[c] = meshes[i].quantization.scale[c];
+            }
+            entries[i].acmrBefore = meshes[i].optimization.acmrBefore;
+            entries[i].acmrAfter = meshes[i].optimization.acmrAfter;
+            entries[i].verticesBeforeWeld = meshes[i].optimization.verticesBeforeWeld;
+            entries[i].verticesAfterWeld = meshes[i].optimization.verticesAfterWeld;
+            for (int c = 0; c < 3; c++)
+                entries[i].boundsCenter[c] = meshes[i].boundsCenter[c];
+            entries[i].boundsRadius = meshes[i].boundsRadius;
+            entries[i].lodCount = (uint32_t) std::min(meshes[i].lods.size(), (size_t) MESH_MAX_LODS);
+            for (uint32_t lod = 0; lod < entries[i].lodCount; lod++) {
+                entries[i].lodIndexOffset[lod] = meshes[i].lods[lod].indexOffset;
+                entries[i].lodIndexCount[lod] = meshes[i].lods[lod].indexCount;
+                entries[i].lodError[lod] = meshes[i].lods[lod].error;
+                entries[i].lodFirstBatch[lod] = meshes[i].lods[lod].firstBatch;
+                entries[i].lodBatchCount[lod] = meshes[i].lods[lod].batchCount;
+            }
+            entries[i].indexType = meshes[i].indexType;
+            entries[i].batchCount = (uint32_t) meshes[i].batches.size();
+            entries[i].vertexCount = (uint32_t) meshes[i].VertexCount();
+            entries[i].indexCount = (uint32_t) meshes[i].IndexCount();
+            entries[i].vertexOffset = offset;
+            offset = align(offset + meshes[i].VertexCount() * VertexStride(meshes[i].format));
+            entries[i].indexOffset = offset;
+            offset = align(offset + meshes[i].IndexCount() * IndexSize(meshes[i].indexType));
+            entries[i].batchOffset = offset;
+            offset = align(offset + meshes[i].batches.size() * sizeof(IndexBatch));
+        }
+
+        // write next to the final file and rename, so a reader never sees a half written cache
+        if (!makeDirectories(Directory()))
+            return false;
+        string path = CachePath(sourcePath);
+        string temporaryPath = path + ".tmp" + to_string(getpid());
+        {
+            ofstream out(temporaryPath, ios::binary);
+            out.write((const char *) &header, sizeof(header));
+            out.write(sourcePath.data(), sourcePath.size());
+            out.write((const char *) entries.data(), entries.size() * sizeof(MeshCacheEntry));
+            out.write(textureRecords.data(), textureRecords.size());
+            for (size_t i = 0; i < meshes.size(); i++) {
+                pad(out, entries[i].vertexOffset);
+                out.write((const char *) meshes[i].VertexData(), meshes[i].VertexCount() * VertexStride(meshes[i].format));
+                pad(out, entries[i].indexOffset);
+                out.write((const char *) meshes[i].IndexData(), meshes[i].IndexCount() * IndexSize(meshes[i].indexType));
+                pad(out, entries[i].batchOffset);
+                out.write((const char *) meshes[i].batches.data(), meshes[i].batches.size() * sizeof(IndexBatch));
+            }
+            if (!out)
+                return false;
+        }
+        return rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+
+private:
+    AssetFile file;
+    vector<MeshData> meshes;
+
+    bool fail()
+    {
+        meshes.clear();
+        file.close();
+        return false;
+    }
+
+    bool readTextures(const MeshCacheEntry &entry, vector<Texture> &textures) const
+    {
+        uint64_t offset = entry.textureOffset;
+        for (uint32_t i = 0; i < entry.textureCount; i++) {
+            uint32_t lengths[2];
+            if (offset + sizeof(lengths) > file.size())
+                return false;
+            memcpy(lengths, file.data() + offset, sizeof(lengths));
+            offset += sizeof(lengths);
+            if (offset + lengths[0] + lengths[1] > file.size())
+                return false;
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign((const char *) file.data() + offset, lengths[0]);
+            texture.path.assign((const char *) file.data() + offset + lengths[0], lengths[1]);
+            offset += lengths[0] + lengths[1];
+            textures.push_back(texture);
+        }
+        return true;
+    }
+
+    static bool statSource(const string &sourcePath, int64_t &mtime, uint64_t &size)
+    {
+        struct stat info;
+        if (stat(sourcePath.c_str(), &info) != 0)
+            return false;
+        mtime = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+        size = (uint64_t) info.st_size;
+        return true;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+    }
+
+    static void pad(ofstream &out, uint64_t offset)
+    {
+        static const char zeros[MESH_CACHE_ALIGNMENT] = {};
+        uint64_t position = (uint64_t) out.tellp();
+        if (offset > position)
+            out.write(zeros, offset - position);
+    }
+};
+#endif
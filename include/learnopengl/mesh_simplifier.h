@@ -0,0 +1,320 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <common.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Level of detail generation by quadric error edge collapse (Garland and Heckbert, "Surface Simplification Using
+// Quadric Error Metrics"). Vertices are only ever collapsed onto one of their neighbours, so every level is an index
+// buffer over the original vertices and all levels share one vertex buffer. Vertices on open borders, non-manifold
+// edges and attribute seams (same position, different normal or UV) stay fixed so the levels don't tear.
+
+// area weighted sum of squared plane distances, error(p) / weight is the mean squared distance of p to the planes
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0, c = 0;
+    double weight = 0;
+
+    static Quadric FromPlane(glm::dvec3 normal, double distance, double weight)
+    {
+        Quadric q;
+        q.a00 = weight * normal.x * normal.x; q.a01 = weight * normal.x * normal.y; q.a02 = weight * normal.x * normal.z;
+        q.a11 = weight * normal.y * normal.y; q.a12 = weight * normal.y * normal.z; q.a22 = weight * normal.z * normal.z;
+        q.b0 = weight * normal.x * distance; q.b1 = weight * normal.y * distance; q.b2 = weight * normal.z * distance;
+        q.c = weight * distance * distance;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o)
+    {
+        a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+        b0 += o.b0; b1 += o.b1; b2 += o.b2; c += o.c;
+        weight += o.weight;
+        return *this;
+    }
+
+    // mean squared distance of p to the accumulated planes
+    double Error(glm::dvec3 p) const
+    {
+        double error = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z
+                     + a11 * p.y * p.y + 2 * a12 * p.y * p.z + a22 * p.z * p.z
+                     + 2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        return weight > 0 ? std::max(error, 0.0) / weight : 0.0;
+    }
+};
+
+// Simplifies a triangle list towards targetTriangles with collapses whose quadric error stays below maxError. The
+// quadric error of a vertex is the root mean square of its distances to the planes of the original triangles around
+// it, an estimate of how far the surface moved there and not a bound on the largest deviation. Returns the new index
+// buffer; error receives the largest quadric error of an applied collapse.
+vector<unsigned int> SimplifyMesh(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                  size_t targetTriangles, float maxError, float &error)
+{
+    error = 0.0f;
+    size_t triangleCount = indices.size() / 3;
+    if(triangleCount <= targetTriangles)
+        return indices;
+
+    // vertices at the same position form one node of the topology
+    vector<unsigned int> nodeOf(vertices.size());
+    vector<unsigned int> nodeVertex;
+    vector<bool> locked;
+    {
+        struct PositionHash {
+            size_t operator()(const glm::vec3 &p) const
+            {
+                return (size_t) fnv1a64(&p, sizeof(p));
+            }
+        };
+        unordered_map<glm::vec3, unsigned int, PositionHash> nodes;
+        nodes.reserve(vertices.size());
+        for(size_t v = 0; v < vertices.size(); v++)
+        {
+            auto inserted = nodes.emplace(vertices[v].Position, (unsigned int) nodeVertex.size());
+            unsigned int node = inserted.first->second;
+            if(inserted.second)
+            {
+                nodeVertex.push_back((unsigned int) v);
+                locked.push_back(false);
+            }
+            else
+            {
+                const Vertex &first = vertices[nodeVertex[node]];
+                if(first.Normal != vertices[v].Normal || first.TexCoords != vertices[v].TexCoords)
+                    locked[node] = true; // attribute seam
+            }
+            nodeOf[v] = node;
+        }
+    }
+    size_t nodeCount = nodeVertex.size();
+
+    vector<unsigned int> triangles(indices.size());
+    for(size_t i = 0; i < indices.size(); i++)
+        triangles[i] = nodeOf[indices[i]];
+    vector<bool> removed(triangleCount, false);
+    size_t liveTriangles = triangleCount;
+
+    // borders and non-manifold edges are the edges not shared by exactly two triangles
+    {
+        unordered_map<uint64_t, unsigned int> edgeUses;
+        edgeUses.reserve(indices.size());
+        for(size_t t = 0; t < triangleCount; t++)
+            for(int e = 0; e < 3; e++)
+            {
+                uint64_t a = triangles[t * 3 + e], b = triangles[t * 3 + (e + 1) % 3];
+                edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+            }
+        for(const auto &edge : edgeUses)
+            if(edge.second != 2)
+                locked[edge.first >> 32] = locked[edge.first & 0xffffffffu] = true;
+    }
+
+    vector<glm::dvec3> positions(nodeCount);
+    for(size_t n = 0; n < nodeCount; n++)
+        positions[n] = glm::dvec3(vertices[nodeVertex[n]].Position);
+
+    vector<Quadric> quadrics(nodeCount);
+    vector<vector<unsigned int>> nodeTriangles(nodeCount);
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        const unsigned int *tri = &triangles[t * 3];
+        glm::dvec3 normal = glm::cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]);
+        double area = glm::length(normal);
+        if(area > 0)
+            normal /= area;
+        Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, positions[tri[0]]), area);
+        for(int corner = 0; corner < 3; corner++)
+        {
+            quadrics[tri[corner]] += q;
+            nodeTriangles[tri[corner]].push_back((unsigned int) t);
+        }
+    }
+
+    // collapse candidates are kept in a priority queue and dropped lazily once one of their nodes changed
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+        bool operator<(const Collapse &o) const { return cost > o.cost; }
+    };
+    vector<unsigned int> version(nodeCount, 0);
+    vector<bool> collapsed(nodeCount, false);
+    priority_queue<Collapse> queue;
+    auto pushEdge = [&](unsigned int a, unsigned int b)
+    {
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+        Collapse collapse;
+        collapse.cost = -1.0;
+        if(!locked[a])
+        {
+            collapse.cost = q.Error(positions[b]);
+            collapse.from = a;
+            collapse.to = b;
+        }
+        if(!locked[b] && (collapse.cost < 0 || q.Error(positions[a]) < collapse.cost))
+        {
+            collapse.cost = q.Error(positions[a]);
+            collapse.from = b;
+            collapse.to = a;
+        }
+        if(collapse.cost < 0)
+            return;
+        collapse.fromVersion = version[collapse.from];
+        collapse.toVersion = version[collapse.to];
+        queue.push(collapse);
+    };
+    for(size_t t = 0; t < triangleCount; t++)
+        for(int e = 0; e < 3; e++)
+            if(triangles[t * 3 + e] < triangles[t * 3 + (e + 1) % 3])
+                pushEdge(triangles[t * 3 + e], triangles[t * 3 + (e + 1) % 3]);
+
+    double maxCost = (double) maxError * maxError;
+    while(liveTriangles > targetTriangles && !queue.empty())
+    {
+        Collapse collapse = queue.top();
+        queue.pop();
+        unsigned int from = collapse.from, to = collapse.to;
+        if(collapsed[from] || collapsed[to] || version[from] != collapse.fromVersion || version[to] != collapse.toVersion)
+            continue;
+        if(collapse.cost > maxCost)
+            break;
+
+        // moving the node must not flip any of the triangles that survive the collapse
+        bool flips = false;
+        for(unsigned int t : nodeTriangles[from])
+        {
+            if(removed[t])
+                continue;
+            const unsigned int *tri = &triangles[t * 3];
+            if(tri[0] == to || tri[1] == to || tri[2] == to)
+                continue;
+            glm::dvec3 p[3], q[3];
+            for(int corner = 0; corner < 3; corner++)
+            {
+                p[corner] = positions[tri[corner]];
+                q[corner] = tri[corner] == from ? positions[to] : p[corner];
+            }
+            glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+            glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+            if(glm::dot(before, after) <= 0.0)
+            {
+                flips = true;
+                break;
+            }
+        }
+        if(flips)
+            continue;
+
+        collapsed[from] = true;
+        quadrics[to] += quadrics[from];
+        version[to]++;
+        error = std::max(error, (float) std::sqrt(collapse.cost));
+        for(unsigned int t : nodeTriangles[from])
+        {
+            if(removed[t])
+                continue;
+            unsigned int *tri = &triangles[t * 3];
+            if(tri[0] == to || tri[1] == to || tri[2] == to)
+            {
+                removed[t] = true;
+                liveTriangles--;
+                continue;
+            }
+            for(int corner = 0; corner < 3; corner++)
+                if(tri[corner] == from)
+                    tri[corner] = to;
+            nodeTriangles[to].push_back(t);
+        }
+        nodeTriangles[from].clear();
+
+        // the costs of every edge around the merged node changed
+        for(unsigned int t : nodeTriangles[to])
+        {
+            if(removed[t])
+                continue;
+            for(int corner = 0; corner < 3; corner++)
+                if(triangles[t * 3 + corner] != to)
+                    pushEdge(to, triangles[t * 3 + corner]);
+        }
+    }
+
+    // vertices that were never collapsed keep their own attributes, moved nodes are unseamed and use their first vertex
+    vector<unsigned int> result;
+    result.reserve(liveTriangles * 3);
+    for(size_t t = 0; t < triangleCount; t++)
+    {
+        if(removed[t])
+            continue;
+        for(int corner = 0; corner < 3; corner++)
+        {
+            unsigned int original = indices[t * 3 + corner];
+            result.push_back(nodeOf[original] == triangles[t * 3 + corner] ? original : nodeVertex[triangles[t * 3 + corner]]);
+        }
+    }
+    return result;
+}
+
+void ComputeBounds(MeshData &mesh)
+{
+    if(mesh.vertices.empty())
+        return;
+    glm::vec3 boundsMin = mesh.vertices[0].Position, boundsMax = boundsMin;
+    for(const Vertex &vertex : mesh.vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
+    mesh.boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    mesh.boundsRadius = 0.0f;
+    for(const Vertex &vertex : mesh.vertices)
+        mesh.boundsRadius = std::max(mesh.boundsRadius, glm::length(vertex.Position - mesh.boundsCenter));
+}
+
+// Appends up to levelCount simplified levels to the index buffer of the mesh, each aiming at half the triangles of the
+// previous one. maxError limits the quadric error of every level and is relative to the bounding radius of the mesh;
+// the chain ends early once a level can't get noticeably smaller within it.
+void GenerateLods(MeshData &mesh, unsigned int levelCount, float maxError)
+{
+    ComputeBounds(mesh);
+    mesh.lods.assign(1, MeshLod());
+    mesh.lods[0].indexCount = (unsigned int) mesh.indices.size();
+    levelCount = std::min(levelCount, MESH_MAX_LODS - 1);
+
+    float errorBound = maxError * mesh.boundsRadius;
+    vector<unsigned int> previous = mesh.indices;
+    float previousError = 0.0f;
+    for(unsigned int level = 1; level <= levelCount; level++)
+    {
+        size_t previousTriangles = previous.size() / 3;
+        float levelError;
+        vector<unsigned int> simplified = SimplifyMesh(mesh.vertices, previous, previousTriangles / 2, errorBound, levelError);
+        if(simplified.empty() || simplified.size() / 3 > previousTriangles * 9 / 10)
+            break;
+        OptimizeTriangleOrder(simplified, mesh.vertices);
+
+        // levels are simplified from each other, so their errors add up
+        MeshLod lod;
+        lod.indexOffset = (unsigned int) mesh.indices.size();
+        lod.indexCount = (unsigned int) simplified.size();
+        lod.error = previousError + levelError;
+        mesh.lods.push_back(lod);
+        mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+        previousError = lod.error;
+    }
+}
+#endif
@@ -0,0 +1,126 @@
+#ifndef MESH_WELDER_H
+#define MESH_WELDER_H
+
+#include <learnopengl/mesh.h>
+#include <ThreadPool.h>
+#include <common.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Merges vertices whose attributes are all equal within an epsilon, which Assimp only does with
+// aiProcess_JoinIdenticalVertices. Without it every face corner of an OBJ file is a vertex of its own and the vertex
+// cache can't reuse anything.
+//
+// Every attribute is snapped to a grid of epsilon sized cells (positions to cells of epsilon times the bounding
+// radius, so the setting doesn't depend on the units of the model) and vertices in the same cells are merged into
+// the first of them. Two vertices closer than epsilon can still land in neighbouring cells and stay apart, which
+// only costs a bit of reuse. An epsilon of 0 merges bitwise identical vertices only.
+
+// the snapped attributes of a vertex: position, normal, texture coordinates, tangent and bitangent
+struct WeldKey {
+    int32_t cells[14];
+
+    bool operator==(const WeldKey &other) const
+    {
+        return memcmp(cells, other.cells, sizeof(cells)) == 0;
+    }
+};
+
+struct WeldKeyHash {
+    size_t operator()(const WeldKey &key) const
+    {
+        return (size_t) fnv1a64(key.cells, sizeof(key.cells));
+    }
+};
+
+int32_t weldCell(float value, float inverseCell)
+{
+    if(inverseCell == 0.0f)
+    {
+        // exact comparison, -0 and 0 are the same value
+        if(value == 0.0f)
+            value = 0.0f;
+        int32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    return (int32_t) std::floor(std::max(std::min(value * inverseCell, 2.0e9f), -2.0e9f));
+}
+
+WeldKey weldKey(const Vertex &vertex, float positionInverseCell, float attributeInverseCell)
+{
+    WeldKey key;
+    int32_t *cell = key.cells;
+    for(int c = 0; c < 3; c++)
+        *cell++ = weldCell(vertex.Position[c], positionInverseCell);
+    for(int c = 0; c < 3; c++)
+        *cell++ = weldCell(vertex.Normal[c], attributeInverseCell);
+    for(int c = 0; c < 2; c++)
+        *cell++ = weldCell(vertex.TexCoords[c], attributeInverseCell);
+    for(int c = 0; c < 3; c++)
+        *cell++ = weldCell(vertex.Tangent[c], attributeInverseCell);
+    for(int c = 0; c < 3; c++)
+        *cell++ = weldCell(vertex.Bitangent[c], attributeInverseCell);
+    return key;
+}
+
+// welds the float vertices of a mesh and remaps its indices, the counts before and after go to mesh.optimization
+void WeldVertices(MeshData &mesh, float epsilon)
+{
+    vector<Vertex> &vertices = mesh.vertices;
+    MeshOptimizationStats &stats = mesh.optimization;
+    stats.verticesBeforeWeld = stats.verticesAfterWeld = (unsigned int) vertices.size();
+    if(vertices.empty())
+        return;
+
+    float radius = 0.0f;
+    if(epsilon > 0.0f)
+    {
+        glm::vec3 low = vertices[0].Position, high = vertices[0].Position;
+        for(const Vertex &vertex : vertices)
+        {
+            low = glm::min(low, vertex.Position);
+            high = glm::max(high, vertex.Position);
+        }
+        radius = glm::length(high - low) * 0.5f;
+    }
+    float positionInverseCell = epsilon > 0.0f && radius > 0.0f ? 1.0f / (epsilon * radius) : 0.0f;
+    float attributeInverseCell = epsilon > 0.0f ? 1.0f / epsilon : 0.0f;
+
+    // the keys are independent, large meshes compute them on all cores; the merge itself stays in vertex order so
+    // the result doesn't depend on the thread count
+    const size_t block = 16384;
+    vector<WeldKey> keys(vertices.size());
+    ThreadPool::Shared().ParallelFor((vertices.size() + block - 1) / block, [&](size_t b)
+    {
+        size_t end = std::min(vertices.size(), (b + 1) * block);
+        for(size_t i = b * block; i < end; i++)
+            keys[i] = weldKey(vertices[i], positionInverseCell, attributeInverseCell);
+    });
+
+    unordered_map<WeldKey, unsigned int, WeldKeyHash> unique;
+    unique.reserve(vertices.size());
+    vector<unsigned int> remap(vertices.size());
+    unsigned int count = 0;
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        auto inserted = unique.insert(make_pair(keys[i], count));
+        if(inserted.second)
+            vertices[count++] = vertices[i];
+        remap[i] = inserted.first->second;
+    }
+    vertices.resize(count);
+    vertices.shrink_to_fit();
+    for(unsigned int &index : mesh.indices)
+        index = remap[index];
+    stats.verticesAfterWeld = count;
+}
+#endif
@@ -10,70 +10,353 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/assimp_io.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/index_format.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/mesh_welder.h>
+#include <learnopengl/obj_loader.h>
+#include <learnopengl/tangent_frames.h>
+#include <learnopengl/vertex_format.h>
 #include <learnopengl/shader.h>
+#include <TextureLoader.h>
+#include <TextureRegistry.h>
+#include <ThreadPool.h>
+#include <Timer.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <chrono>
+#include <future>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+class Model;
+void PrintModelLoadReport(const vector<const Model *> &models, double wallMilliseconds);
 
+// post-processing applied to every imported model, also part of the mesh cache key. Smooth normals and tangents
+// come from GenerateTangentFrames instead of aiProcess_GenSmoothNormals and aiProcess_CalcTangentSpace.
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+
+// processing done by Model::Import on top of the Assimp flags; everything in here is part of the mesh cache key
+struct ModelImportOptions
+{
+    VertexFormat vertexFormat = VERTEX_FORMAT_FLOAT;
+    bool weldVertices = true;   // merges face corners with equal attributes, see mesh_welder.h
+    float weldEpsilon = 1e-4f;  // attribute tolerance of the welding, positions relative to the bounding radius
+    bool optimizeMeshes = true; // vertex cache, overdraw and vertex fetch reordering
+    unsigned int lodLevels = 0; // simplified levels generated on top of the full mesh, at most MESH_MAX_LODS - 1
+    float lodMaxError = 0.02f;  // largest quadric error of any level, relative to the bounding radius of the mesh
+    CpuGeometry cpuGeometry = CPU_GEOMETRY_KEEP; // what the meshes keep after the upload, not part of the cache key
+
+    // the key for the model at path, which also records whether the native OBJ loader reads it or Assimp does
+    uint64_t Key(const string &path) const
+    {
+        bool nativeObj = ObjLoader::Enabled() && ObjLoader::Handles(path);
+        uint32_t values[] = {(uint32_t) vertexFormat, weldVertices, 0, optimizeMeshes, lodLevels, 0, nativeObj};
+        memcpy(&values[2], &weldEpsilon, sizeof(float));
+        memcpy(&values[5], &lodMaxError, sizeof(float));
+        return fnv1a64(values, sizeof(values));
+    }
+};
+
+// result of importing a model on a worker thread; holds everything Model needs to create its GL objects
+struct ModelData
+{
+    string path;
+    string directory;
+    vector<MeshData> meshes;
+    shared_ptr<MeshCache> cache; // keeps the mapped cache file alive until the meshes are uploaded
+    bool fromCache = false;
+    double importMilliseconds = 0.0;
+    CpuGeometry cpuGeometry = CPU_GEOMETRY_KEEP;
+};
+
+// per model load timings, reported after startup
+struct ModelLoadStats
+{
+    string path;
+    bool fromCache = false;
+    double importMilliseconds = 0.0;
+    double uploadMilliseconds = 0.0; // on the GL thread, with a loader thread only creating the meshes
+    double readyMilliseconds = 0.0;  // from the constructor until every buffer was on the GPU
+    size_t vertexBytes = 0;      // vertex buffers in the format the model was imported with
+    size_t floatVertexBytes = 0; // the same vertices in the full float layout
+    size_t indexBytes = 0;
+    size_t floatIndexBytes = 0;  // the same indices if all were 32-bit
+    size_t cpuBytes = 0;         // geometry kept on the CPU after the upload
+    vector<MeshOptimizationStats> meshOptimization;
+    vector<size_t> lodTriangles; // triangles of the whole model at each level of detail
+};
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// one entry per texture reference this model holds in the TextureRegistry
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    ModelLoadStats stats;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, const ModelImportOptions &options = ModelImportOptions()) : Model(Import(path, options), gamma)
+    {
+    }
+
+    // creates the GL objects of an already imported model, has to run on the thread owning the GL context
+    Model(ModelData data, bool gamma = false) : directory(data.directory), gammaCorrection(gamma)
     {
-        loadModel(path);
+        createMeshes(std::move(data));
+        Ready();
     }
 
-    // draws the model, and thus all its meshes
+    // a model whose import is still running; Ready picks the result up once it is there, until then and until its
+    // buffers are uploaded Draw skips the model. Textures are flipped as TextureLoader::FlipVertically is set now.
+    Model(future<ModelData> import, bool gamma = false) : gammaCorrection(gamma), import(std::move(import)),
+                                                           flipTextures(TextureLoader::FlipVertically())
+    {
+    }
+
+    // true once the import is done and every mesh is on the GPU; called by Draw, on the GL thread
+    bool Ready()
+    {
+        if(ready)
+            return true;
+        if(import.valid())
+        {
+            if(import.wait_for(std::chrono::seconds(0)) != future_status::ready)
+                return false;
+            bool flip = TextureLoader::FlipVertically();
+            TextureLoader::FlipVertically() = flipTextures;
+            ModelData data = import.get();
+            directory = data.directory;
+            createMeshes(std::move(data));
+            TextureLoader::FlipVertically() = flip;
+        }
+        for(Mesh &mesh : meshes)
+            if(!mesh.Ready())
+                return false;
+        cache.reset();
+        for(const Mesh &mesh : meshes)
+            stats.cpuBytes += mesh.CpuBytes();
+        stats.readyMilliseconds = readyTimer.Milliseconds();
+        ready = true;
+        return true;
+    }
+
+    // reads and post-processes a model without making any GL calls, so it can run on a worker thread.
+    // loads a model with supported ASSIMP extensions from file, or from the mesh cache when it is up to date.
+    static ModelData Import(string const &path, const ModelImportOptions &options = ModelImportOptions())
+    {
+        Timer timer;
+        ModelData data;
+        data.path = path;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+        data.cpuGeometry = options.cpuGeometry;
+
+        // a valid cache holds the already processed meshes, they get uploaded straight from the mapped file
+        if(MeshCache::Enabled())
+        {
+            shared_ptr<MeshCache> cache = make_shared<MeshCache>();
+            if(cache->Open(path, MODEL_IMPORT_FLAGS, options.Key(path)))
+            {
+                data.meshes = std::move(cache->Meshes());
+                data.cache = cache;
+                data.fromCache = true;
+                data.importMilliseconds = timer.Milliseconds();
+                return data;
+            }
+        }
+
+        // OBJ files go through the native parallel loader, Assimp handles everything else and whatever it rejects
+        if(!(ObjLoader::Enabled() && ObjLoader::Handles(path) && ObjLoader::Load(path, data.meshes)))
+        {
+            data.meshes.clear();
+            // read file via ASSIMP, through the asset file system like everything else
+            Assimp::Importer importer;
+            importer.SetIOHandler(new AssetIOSystem());
+            const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return data;
+            }
+
+            // process ASSIMP's root node recursively
+            data.meshes.reserve(scene->mNumMeshes);
+            processNode(scene->mRootNode, scene, data.meshes);
+        }
+
+        // add normals and tangents, weld, reorder for the GPU caches, then build the GPU vertex layout last, after all processing on the float
+        // vertices; the meshes are independent and get processed in parallel
+        ThreadPool::Shared().ParallelFor(data.meshes.size(), [&](size_t i)
+        {
+            MeshData &mesh = data.meshes[i];
+            GenerateTangentFrames(mesh);
+            if(options.weldVertices)
+                WeldVertices(mesh, options.weldEpsilon);
+            if(options.optimizeMeshes)
+                OptimizeMesh(mesh);
+            else
+                mesh.optimization.acmrBefore = mesh.optimization.acmrAfter =
+                        VertexCacheMissRatio(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+            GenerateLods(mesh, options.lodLevels, options.lodMaxError);
+            PackIndices(mesh);
+            PackVertices(mesh, options.vertexFormat);
+        });
+
+        if(MeshCache::Enabled() && !MeshCache::Write(path, MODEL_IMPORT_FLAGS, options.Key(path), data.meshes))
+            cout << "WARNING::MESH_CACHE:: failed to write cache for " << path << endl;
+
+        data.importMilliseconds = timer.Milliseconds();
+        return data;
+    }
+
+    // starts the import on the shared thread pool, the result is passed to the Model constructor on the GL thread
+    static future<ModelData> ImportAsync(string const &path, const ModelImportOptions &options = ModelImportOptions())
+    {
+        return ThreadPool::Shared().Submit([path, options]() { return Import(path, options); });
+    }
+
+    // draws the model, and thus all its meshes, each at the level of detail picked by the last SelectLod
     void Draw(Shader &shader)
     {
+        if(!Ready())
+            return;
         for(unsigned int i = 0; i < meshes.size(); i++)
+        {
             meshes[i].Draw(shader);
+            FrameTriangles() += meshes[i].lods[meshes[i].currentLod].indexCount / 3;
+        }
+    }
+
+    // largest geometric error a level may show on screen, in pixels
+    static float &LodPixelError()
+    {
+        static float pixels = 1.0f;
+        return pixels;
+    }
+
+    // a mesh only switches to a coarser level once that level's error is this fraction below LodPixelError,
+    // so a camera resting at a level boundary doesn't make it flicker between two levels
+    static float &LodHysteresis()
+    {
+        static float hysteresis = 0.25f;
+        return hysteresis;
+    }
+
+    // triangles submitted by all Draw calls since the counter was last reset, the application resets it every frame
+    static size_t &FrameTriangles()
+    {
+        static size_t triangles = 0;
+        return triangles;
+    }
+
+    // picks the level of detail of every mesh from the error it would project to on screen.
+    // projectionScale converts a world space size at distance 1 to pixels: viewportHeight / (2 * tan(fovy / 2)).
+    void SelectLod(const glm::mat4 &modelMatrix, const glm::vec3 &cameraPosition, float projectionScale)
+    {
+        // the largest axis scale bounds how much the model matrix can stretch an object space error
+        float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+                               std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+        float threshold = LodPixelError();
+        for(Mesh &mesh : meshes)
+        {
+            glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(mesh.boundsCenter, 1.0f));
+            float distance = std::max(glm::length(center - cameraPosition) - mesh.boundsRadius * scale, 1e-3f);
+            float pixelsPerUnit = scale * projectionScale / distance;
+
+            // refine right away while the current level shows too much error, coarsen only once the next level is
+            // comfortably below the threshold
+            unsigned int level = std::min(mesh.currentLod, (unsigned int) mesh.lods.size() - 1);
+            while(level > 0 && mesh.lods[level].error * pixelsPerUnit > threshold)
+                level--;
+            while(level + 1 < mesh.lods.size() && mesh.lods[level + 1].error * pixelsPerUnit <= threshold * (1.0f - LodHysteresis()))
+                level++;
+            mesh.currentLod = level;
+        }
+    }
+
+    // triangles of the whole model at each generated level of detail
+    vector<size_t> LodTriangleCounts() const
+    {
+        size_t levels = 0;
+        for(const Mesh &mesh : meshes)
+            levels = std::max(levels, mesh.lods.size());
+        // meshes with fewer levels contribute their coarsest one to the remaining levels
+        vector<size_t> counts(levels, 0);
+        for(const Mesh &mesh : meshes)
+            for(size_t level = 0; level < levels; level++)
+                counts[level] += mesh.lods[std::min(level, mesh.lods.size() - 1)].indexCount / 3;
+        return counts;
+    }
+
+    // drops this model's references to its textures, the last user of a texture deletes it
+    void ReleaseTextures()
+    {
+        for(const Texture &texture : textures_loaded)
+            TextureRegistry::Instance().Release(texture.id);
+        textures_loaded.clear();
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
+        shaderTextureNamePrefix = prefix;
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+    future<ModelData> import;
+    shared_ptr<MeshCache> cache;
+    bool flipTextures = false;
+    bool ready = false;
+    Timer readyTimer;
+    std::string shaderTextureNamePrefix;
+
+    // creates the meshes and starts their uploads
+    void createMeshes(ModelData data)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+        Timer timer;
+        meshes.reserve(data.meshes.size());
+        for(MeshData &mesh : data.meshes)
         {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            vector<Texture> textures;
+            textures.reserve(mesh.textures.size());
+            for(const Texture &texture : mesh.textures)
+                textures.push_back(loadMaterialTexture(texture.path.c_str(), texture.type));
+            stats.floatIndexBytes += mesh.IndexCount() * sizeof(unsigned int);
+            stats.meshOptimization.push_back(mesh.optimization);
+            // the mesh takes over the imported arrays and frees what cpuGeometry doesn't keep
+            meshes.push_back(Mesh(std::move(mesh), std::move(textures), data.cpuGeometry));
+            meshes.back().glslIdentifierPrefix = shaderTextureNamePrefix;
+            stats.vertexBytes += meshes.back().vertexBytes;
+            stats.floatVertexBytes += meshes.back().floatVertexBytes;
+            stats.indexBytes += meshes.back().indexBytes;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
-
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        data.meshes.clear();
+        // the meshes upload from the mapped cache file and read back what they keep from it once they are done
+        cache = std::move(data.cache);
+        stats.lodTriangles = LodTriangleCounts();
+        stats.path = data.path;
+        stats.fromCache = data.fromCache;
+        stats.importMilliseconds = data.importMilliseconds;
+        stats.uploadMilliseconds = timer.Milliseconds();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshes)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -86,17 +369,20 @@ private:
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve((size_t) mesh->mNumFaces * 3); // faces are triangles after aiProcess_Triangulate
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -108,7 +394,8 @@ private:
             vector.y = mesh->mVertices[i].y;
             vector.z = mesh->mVertices[i].z;
             vertex.Position = vector;
-            // normals
+            // normals, zero ones are generated by GenerateTangentFrames
+            vertex.Normal = glm::vec3(0.0f);
             if (mesh->HasNormals())
             {
                 vector.x = mesh->mNormals[i].x;
@@ -125,19 +412,12 @@ private:
                 vec.x = mesh->mTextureCoords[0][i].x;
                 vec.y = mesh->mTextureCoords[0][i].y;
                 vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+            // tangent and bitangent, filled in by GenerateTangentFrames
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
 
             vertices.push_back(vertex);
 
@@ -178,42 +458,38 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, the GL objects are created later on the GL thread
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
+    // collects all material textures of a given type, they are loaded when the model is uploaded.
     // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    Texture loadMaterialTexture(const char *path, const string &typeName)
+    {
+        // the registry makes sure a texture is only loaded once, across all models
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
+    }
 };
 
 
@@ -222,38 +498,52 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    // shared with every other user of the same image; the texture starts out as a placeholder,
+    // TextureLoader uploads the image once it is decoded
+    return TextureRegistry::Instance().Acquire2D(filename);
+}
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
+// prints the per model import/upload times next to the wall time of the whole loading stage.
+// with parallel imports the wall time should approach the slowest model instead of the sum.
+void PrintModelLoadReport(const vector<const Model *> &models, double wallMilliseconds)
+{
+    double sum = 0.0;
+    size_t vertexBytes = 0, floatVertexBytes = 0, indexBytes = 0, floatIndexBytes = 0, cpuBytes = 0;
+    cout << "Model loading:" << endl;
+    for(const Model *model : models)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        const ModelLoadStats &stats = model->stats;
+        printf("  %-50s import %8.2f ms%s, upload %7.2f ms, ready %8.2f ms, vertices %7.2f MB (float layout %7.2f MB), indices %6.2f MB (32-bit %6.2f MB)\n",
+               stats.path.c_str(), stats.importMilliseconds, stats.fromCache ? " (cache)" : "        ",
+               stats.uploadMilliseconds, stats.readyMilliseconds, stats.vertexBytes / 1048576.0, stats.floatVertexBytes / 1048576.0,
+               stats.indexBytes / 1048576.0, stats.floatIndexBytes / 1048576.0);
+        printf("    triangles per level of detail:");
+        for(size_t triangles : stats.lodTriangles)
+            printf(" %zu", triangles);
+        printf("\n");
+        size_t weldedFrom = 0, weldedTo = 0;
+        for(const MeshOptimizationStats &mesh : stats.meshOptimization)
+        {
+            weldedFrom += mesh.verticesBeforeWeld;
+            weldedTo += mesh.verticesAfterWeld;
+        }
+        if(weldedFrom > 0)
+            printf("    welding: %zu -> %zu vertices (%.1f%% fewer)\n", weldedFrom, weldedTo,
+                   100.0 * (double) (weldedFrom - weldedTo) / (double) weldedFrom);
+        for(size_t i = 0; i < stats.meshOptimization.size(); i++)
+            printf("    mesh %zu: ACMR %.3f -> %.3f, %s indices in %zu draw batches\n", i, stats.meshOptimization[i].acmrBefore,
+                   stats.meshOptimization[i].acmrAfter, model->meshes[i].indexType == GL_UNSIGNED_SHORT ? "16-bit" : "32-bit",
+                   model->meshes[i].batches.size());
+        sum += stats.importMilliseconds + stats.uploadMilliseconds;
+        vertexBytes += stats.vertexBytes;
+        floatVertexBytes += stats.floatVertexBytes;
+        indexBytes += stats.indexBytes;
+        floatIndexBytes += stats.floatIndexBytes;
+        cpuBytes += stats.cpuBytes;
     }
-
-    return textureID;
+    printf("  sum of all models %.2f ms, wall time %.2f ms\n", sum, wallMilliseconds);
+    printf("  vertex memory %.2f MB, %.2f MB in the float layout\n", vertexBytes / 1048576.0, floatVertexBytes / 1048576.0);
+    printf("  index memory %.2f MB, %.2f MB with 32-bit indices\n", indexBytes / 1048576.0, floatIndexBytes / 1048576.0);
+    printf("  geometry kept on the CPU %.2f MB\n", cpuBytes / 1048576.0);
 }
 #endif
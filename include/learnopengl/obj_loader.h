@@ -0,0 +1,570 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <learnopengl/mesh.h>
+#include <AssetFileSystem.h>
+#include <ThreadPool.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Native Wavefront OBJ/MTL loader, the fast path of Model::Import for .obj files. The file is memory mapped and cut
+// into line aligned chunks that are parsed in parallel on the shared thread pool; the chunks are then stitched
+// together and turned into meshes the same way Assimp does it with MODEL_IMPORT_FLAGS: one mesh per run of faces
+// with the same object/group and material, polygons triangulated as fans, one vertex per face corner, V flipped.
+// Missing normals and the tangents are left zero for GenerateTangentFrames, like for meshes coming from Assimp.
+//
+// Load returns false for anything it does not understand, Model::Import then falls back to Assimp.
+class ObjLoader {
+public:
+    static bool &Enabled()
+    {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    static bool Handles(const string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        if(dot == string::npos)
+            return false;
+        string extension = path.substr(dot + 1);
+        for(char &c : extension)
+            c = (char) tolower(c);
+        return extension == "obj";
+    }
+
+    static bool Load(const string &path, vector<MeshData> &meshes)
+    {
+        AssetFile file(path);
+        if(!file.isOpen())
+            return false;
+        const char *text = (const char *) file.data();
+        size_t size = file.size();
+
+        // line aligned chunks, a few per worker so uneven chunks balance out
+        const size_t minimumChunk = 256 * 1024;
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(ThreadPool::Shared().Size() * 4, size / minimumChunk));
+        vector<size_t> bounds(chunkCount + 1, size);
+        bounds[0] = 0;
+        for(size_t i = 1; i < chunkCount; i++)
+        {
+            size_t position = std::max(bounds[i - 1], size * i / chunkCount);
+            while(position < size && text[position - 1] != '\n')
+                position++;
+            bounds[i] = position;
+        }
+
+        vector<Chunk> chunks(chunkCount);
+        ThreadPool::Shared().ParallelFor(chunkCount, [&](size_t i) { parseChunk(text + bounds[i], text + bounds[i + 1], chunks[i]); });
+
+        for(const Chunk &chunk : chunks)
+            if(chunk.failed)
+                return false;
+
+        // stitch the chunks: global attribute arrays, relative indices resolved against the offsets of their chunk
+        size_t positionBase = 0, texCoordBase = 0, normalBase = 0;
+        for(Chunk &chunk : chunks)
+        {
+            for(Corner &corner : chunk.corners)
+            {
+                resolve(corner.position, corner.relative & Corner::POSITION, positionBase);
+                resolve(corner.texCoord, corner.relative & Corner::TEXCOORD, texCoordBase);
+                resolve(corner.normal, corner.relative & Corner::NORMAL, normalBase);
+            }
+            positionBase += chunk.positions.size();
+            texCoordBase += chunk.texCoords.size();
+            normalBase += chunk.normals.size();
+        }
+        Attributes attributes;
+        attributes.positions.reserve(positionBase);
+        attributes.texCoords.reserve(texCoordBase);
+        attributes.normals.reserve(normalBase);
+        for(Chunk &chunk : chunks)
+        {
+            attributes.positions.insert(attributes.positions.end(), chunk.positions.begin(), chunk.positions.end());
+            attributes.texCoords.insert(attributes.texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+            attributes.normals.insert(attributes.normals.end(), chunk.normals.begin(), chunk.normals.end());
+            vector<glm::vec3>().swap(chunk.positions);
+            vector<glm::vec2>().swap(chunk.texCoords);
+            vector<glm::vec3>().swap(chunk.normals);
+        }
+
+        string directory = path.substr(0, path.find_last_of('/'));
+        unordered_map<string, vector<Texture>> materials;
+        for(const Chunk &chunk : chunks)
+            for(const string &library : chunk.materialLibraries)
+                readMaterialLibrary(directory + '/' + library, materials);
+
+        // a new mesh starts whenever the object/group or the material changes, a run may span several chunks
+        vector<Run> runs;
+        string object, material;
+        bool changed = true;
+        for(size_t c = 0; c < chunks.size(); c++)
+        {
+            const Chunk &chunk = chunks[c];
+            size_t event = 0;
+            for(size_t face = 0; face <= chunk.faces.size(); face++)
+            {
+                // events after the last face of a chunk carry over to the first face of the next one
+                for(; event < chunk.events.size() && chunk.events[event].face == face; event++)
+                {
+                    const StateEvent &change = chunk.events[event];
+                    string &target = change.type == StateEvent::MATERIAL ? material : object;
+                    changed |= target != change.name;
+                    target = change.name;
+                }
+                if(face == chunk.faces.size())
+                    break;
+                if(changed)
+                {
+                    runs.push_back(Run());
+                    runs.back().material = material;
+                    changed = false;
+                }
+                vector<Segment> &segments = runs.back().segments;
+                if(segments.empty() || segments.back().chunk != c)
+                    segments.push_back(Segment{c, face, 0});
+                segments.back().faceCount++;
+            }
+        }
+
+        size_t firstMesh = meshes.size();
+        meshes.resize(firstMesh + runs.size());
+        vector<char> valid(runs.size(), 0);
+        ThreadPool::Shared().ParallelFor(runs.size(), [&](size_t r)
+        {
+            MeshData &mesh = meshes[firstMesh + r];
+            valid[r] = buildMesh(chunks, runs[r], attributes, mesh);
+            auto found = materials.find(runs[r].material);
+            if(found != materials.end())
+                mesh.textures = found->second;
+        });
+        if(std::find(valid.begin(), valid.end(), 0) != valid.end())
+        {
+            meshes.resize(firstMesh);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // 1-based as in the file and 0 when the corner has no such attribute; negative (relative) indices are turned
+    // into 0-based indices into the chunk's own arrays, flagged in relative, since the chunk's offset is not known
+    // while it is parsed. After resolve() every index is 0-based and global, -1 when missing.
+    struct Corner {
+        enum { POSITION = 1, TEXCOORD = 2, NORMAL = 4 };
+        long long position = 0, texCoord = 0, normal = 0;
+        unsigned char relative = 0;
+    };
+
+    struct StateEvent {
+        enum Type { OBJECT, MATERIAL } type;
+        size_t face; // applies from this face of the chunk on
+        string name;
+    };
+
+    struct Chunk {
+        vector<glm::vec3> positions, normals;
+        vector<glm::vec2> texCoords;
+        vector<Corner> corners;
+        vector<uint32_t> faces; // offset of the first corner of each face, the face ends where the next one starts
+        vector<StateEvent> events;
+        vector<string> materialLibraries;
+        bool failed = false;
+
+        size_t FaceEnd(size_t face) const
+        {
+            return face + 1 < faces.size() ? faces[face + 1] : corners.size();
+        }
+    };
+
+    struct Segment {
+        size_t chunk, firstFace, faceCount;
+    };
+
+    struct Run {
+        string material;
+        vector<Segment> segments;
+    };
+
+    struct Attributes {
+        vector<glm::vec3> positions, normals;
+        vector<glm::vec2> texCoords;
+    };
+
+    static const char *skipSpaces(const char *p, const char *end)
+    {
+        while(p < end && (*p == ' ' || *p == '\t'))
+            p++;
+        return p;
+    }
+
+    static const char *lineEnd(const char *p, const char *end)
+    {
+        const char *newline = (const char *) memchr(p, '\n', end - p);
+        return newline ? newline : end;
+    }
+
+    // the rest of the line without surrounding whitespace, names and file names may contain spaces
+    static string restOfLine(const char *p, const char *end)
+    {
+        p = skipSpaces(p, end);
+        while(end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+            end--;
+        return string(p, end);
+    }
+
+    // Decimal float parser for the numbers OBJ files contain. Up to 19 significant digits are accumulated in an
+    // integer and scaled by an exact power of ten, which is correctly rounded for the usual 4-9 digit values;
+    // anything unusual (inf, nan, hex, huge exponents) goes to strtod.
+    static const char *parseFloat(const char *p, const char *end, float &value)
+    {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        const char *start = p;
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+
+        uint64_t mantissa = 0;
+        int digits = 0, exponent = 0;
+        bool any = false;
+        for(; p < end && *p >= '0' && *p <= '9'; p++, any = true)
+        {
+            if(digits < 19)
+                mantissa = mantissa * 10 + (*p - '0'), digits += mantissa != 0;
+            else
+                exponent++;
+        }
+        if(p < end && *p == '.')
+        {
+            for(p++; p < end && *p >= '0' && *p <= '9'; p++, any = true)
+            {
+                if(digits < 19)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa != 0;
+                    exponent--;
+                }
+            }
+        }
+        if(!any)
+            return slowFloat(start, end, value);
+        if(p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if(q < end && (*q == '-' || *q == '+'))
+                negativeExponent = *q++ == '-';
+            if(q >= end || *q < '0' || *q > '9')
+                return slowFloat(start, end, value);
+            int e = 0;
+            for(; q < end && *q >= '0' && *q <= '9'; q++)
+                e = std::min(e * 10 + (*q - '0'), 10000);
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+        if(p < end && (*p == 'x' || *p == 'X' || *p == 'n' || *p == 'N' || *p == 'i' || *p == 'I'))
+            return slowFloat(start, end, value);
+
+        double result = (double) mantissa;
+        if(exponent < -22 || exponent > 22)
+            return slowFloat(start, end, value);
+        result = exponent < 0 ? result / powers[-exponent] : result * powers[exponent];
+        value = (float) (negative ? -result : result);
+        return p;
+    }
+
+    static const char *slowFloat(const char *p, const char *end, float &value)
+    {
+        char buffer[64];
+        size_t length = std::min<size_t>(sizeof(buffer) - 1, end - p);
+        memcpy(buffer, p, length);
+        buffer[length] = 0;
+        char *parsedEnd;
+        value = strtof(buffer, &parsedEnd);
+        return p + (parsedEnd - buffer);
+    }
+
+    static const char *parseInteger(const char *p, const char *end, long long &value)
+    {
+        bool negative = false;
+        if(p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        long long result = 0;
+        for(; p < end && *p >= '0' && *p <= '9'; p++)
+            result = result * 10 + (*p - '0');
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // reads up to count floats of a v/vt/vn line, missing trailing components stay as they are
+    static bool parseFloats(const char *p, const char *end, float *values, int count, int required)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            p = skipSpaces(p, end);
+            if(p >= end || *p == '\r')
+                return i >= required;
+            const char *next = parseFloat(p, end, values[i]);
+            if(next == p)
+                return false;
+            p = next;
+        }
+        return true;
+    }
+
+    static void parseChunk(const char *p, const char *end, Chunk &chunk)
+    {
+        while(p < end)
+        {
+            const char *eol = lineEnd(p, end);
+            p = skipSpaces(p, eol);
+            if(p + 1 < eol && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                float v[3] = {0, 0, 0};
+                if(!parseFloats(p + 2, eol, v, 3, 3))
+                    chunk.failed = true;
+                chunk.positions.push_back(glm::vec3(v[0], v[1], v[2]));
+            }
+            else if(p + 2 < eol && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+            {
+                float v[3] = {0, 0, 0};
+                if(!parseFloats(p + 3, eol, v, 3, 3))
+                    chunk.failed = true;
+                chunk.normals.push_back(glm::vec3(v[0], v[1], v[2]));
+            }
+            else if(p + 2 < eol && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+            {
+                float v[2] = {0, 0};
+                if(!parseFloats(p + 3, eol, v, 2, 1))
+                    chunk.failed = true;
+                chunk.texCoords.push_back(glm::vec2(v[0], v[1]));
+            }
+            else if(p + 1 < eol && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+                parseFace(p + 2, eol, chunk);
+            else if(startsWith(p, eol, "usemtl"))
+                chunk.events.push_back(StateEvent{StateEvent::MATERIAL, chunk.faces.size(), restOfLine(p + 6, eol)});
+            else if(startsWith(p, eol, "o") || startsWith(p, eol, "g"))
+                chunk.events.push_back(StateEvent{StateEvent::OBJECT, chunk.faces.size(), restOfLine(p + 1, eol)});
+            else if(startsWith(p, eol, "mtllib"))
+                chunk.materialLibraries.push_back(restOfLine(p + 6, eol));
+            // comments, smoothing groups, lines, points and unknown statements are ignored, like Assimp does
+            p = eol + 1;
+        }
+    }
+
+    static bool startsWith(const char *p, const char *end, const char *keyword)
+    {
+        size_t length = strlen(keyword);
+        return (size_t) (end - p) > length && memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+    }
+
+    static void parseFace(const char *p, const char *end, Chunk &chunk)
+    {
+        size_t first = chunk.corners.size();
+        while(true)
+        {
+            p = skipSpaces(p, end);
+            if(p >= end || *p == '\r')
+                break;
+            Corner corner;
+            const char *next = parseInteger(p, end, corner.position);
+            if(next == p || corner.position == 0)
+            {
+                chunk.failed = true;
+                return;
+            }
+            p = next;
+            if(p < end && *p == '/')
+            {
+                p++;
+                if(p < end && *p != '/')
+                    p = parseInteger(p, end, corner.texCoord);
+                if(p < end && *p == '/')
+                    p = parseInteger(p + 1, end, corner.normal);
+            }
+            // relative indices count back from the end of what was defined so far
+            if(corner.position < 0)
+                corner.position += (long long) chunk.positions.size(), corner.relative |= Corner::POSITION;
+            if(corner.texCoord < 0)
+                corner.texCoord += (long long) chunk.texCoords.size(), corner.relative |= Corner::TEXCOORD;
+            if(corner.normal < 0)
+                corner.normal += (long long) chunk.normals.size(), corner.relative |= Corner::NORMAL;
+            chunk.corners.push_back(corner);
+        }
+        if(chunk.corners.size() - first < 3)
+        {
+            // lines and points are skipped
+            chunk.corners.resize(first);
+            return;
+        }
+        chunk.faces.push_back((uint32_t) first);
+    }
+
+    // turns an index into a 0-based global one, -1 when the attribute is missing
+    static void resolve(long long &index, bool relative, size_t chunkBase)
+    {
+        if(relative)
+            index += (long long) chunkBase;
+        else
+            index -= 1;
+    }
+
+    static void readMaterialLibrary(const string &path, unordered_map<string, vector<Texture>> &materials)
+    {
+        AssetFile file(path);
+        const char *text = (const char *) file.data(), *textEnd = text + file.size();
+        vector<Texture> *current = nullptr;
+        for(const char *begin = text, *end; begin < textEnd; begin = end + 1)
+        {
+            end = lineEnd(begin, textEnd);
+            const char *p = skipSpaces(begin, end);
+            if(startsWith(p, end, "newmtl"))
+            {
+                current = &materials[restOfLine(p + 6, end)];
+                current->clear();
+                continue;
+            }
+            if(!current)
+                continue;
+            // the same texture types Model reads from Assimp's materials: diffuse, specular, height (bump) and ambient
+            static const char *keywords[][2] = {
+                    {"map_Kd", "texture_diffuse"}, {"map_Ks", "texture_specular"},
+                    {"map_Bump", "texture_normal"}, {"map_bump", "texture_normal"}, {"bump", "texture_normal"},
+                    {"map_Ka", "texture_height"},
+            };
+            for(const auto &keyword : keywords)
+            {
+                if(!startsWith(p, end, keyword[0]))
+                    continue;
+                Texture texture;
+                texture.id = 0;
+                texture.type = keyword[1];
+                texture.path = textureFileName(restOfLine(p + strlen(keyword[0]), end));
+                current->push_back(texture);
+                break;
+            }
+        }
+        // Model expects the textures grouped by type in this order
+        static const char *order[] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+        for(auto &material : materials)
+        {
+            vector<Texture> sorted;
+            for(const char *type : order)
+                for(const Texture &texture : material.second)
+                    if(texture.type == type)
+                        sorted.push_back(texture);
+            material.second.swap(sorted);
+        }
+    }
+
+    // drops texture options like "-bm 0.5" in front of the file name, the file name itself may contain spaces
+    static string textureFileName(const string &arguments)
+    {
+        size_t position = 0;
+        auto nextToken = [&](size_t &begin) -> string
+        {
+            begin = arguments.find_first_not_of(" \t", position);
+            if(begin == string::npos)
+                return string();
+            size_t end = arguments.find_first_of(" \t", begin);
+            position = end == string::npos ? arguments.size() : end;
+            return arguments.substr(begin, position - begin);
+        };
+        size_t begin;
+        string token = nextToken(begin);
+        // options take up to three numbers (-o/-s/-t) or one word (-clamp on, -imfchan r, -type sphere)
+        while(!token.empty() && token[0] == '-' && token.size() > 1 && !isdigit((unsigned char) token[1]))
+        {
+            bool numeric = token == "-o" || token == "-s" || token == "-t" || token == "-mm" ||
+                           token == "-bm" || token == "-boost" || token == "-texres";
+            int count = numeric ? 3 : 1;
+            for(int i = 0; i < count; i++)
+            {
+                size_t start = position;
+                string value = nextToken(begin);
+                char *numberEnd;
+                strtod(value.c_str(), &numberEnd);
+                if(numeric && (value.empty() || *numberEnd != 0))
+                {
+                    position = start;
+                    break;
+                }
+            }
+            token = nextToken(begin);
+        }
+        if(token.empty())
+            return string();
+        return arguments.substr(begin);
+    }
+
+    // one vertex per face corner like Assimp's OBJ importer, polygons triangulated as fans over those vertices;
+    // normals the file doesn't have and tangents stay zero for GenerateTangentFrames
+    static bool buildMesh(const vector<Chunk> &chunks, const Run &run, const Attributes &attributes, MeshData &mesh)
+    {
+        size_t corners = 0, triangles = 0;
+        for(const Segment &segment : run.segments)
+        {
+            const Chunk &chunk = chunks[segment.chunk];
+            for(size_t face = segment.firstFace; face < segment.firstFace + segment.faceCount; face++)
+            {
+                corners += chunk.FaceEnd(face) - chunk.faces[face];
+                triangles += chunk.FaceEnd(face) - chunk.faces[face] - 2;
+            }
+        }
+        mesh.vertices.reserve(corners);
+        mesh.indices.reserve(triangles * 3);
+
+        for(const Segment &segment : run.segments)
+        {
+            const Chunk &chunk = chunks[segment.chunk];
+            for(size_t face = segment.firstFace; face < segment.firstFace + segment.faceCount; face++)
+            {
+                unsigned int first = (unsigned int) mesh.vertices.size();
+                for(size_t corner = chunk.faces[face]; corner < chunk.FaceEnd(face); corner++)
+                {
+                    const Corner &c = chunk.corners[corner];
+                    if(!inRange(c.position, attributes.positions.size()) ||
+                       (c.texCoord != -1 && !inRange(c.texCoord, attributes.texCoords.size())) ||
+                       (c.normal != -1 && !inRange(c.normal, attributes.normals.size())))
+                        return false;
+                    Vertex vertex = Vertex();
+                    vertex.Position = attributes.positions[c.position];
+                    if(c.texCoord >= 0)
+                    {
+                        // aiProcess_FlipUVs
+                        glm::vec2 uv = attributes.texCoords[c.texCoord];
+                        vertex.TexCoords = glm::vec2(uv.x, 1.0f - uv.y);
+                    }
+                    if(c.normal >= 0)
+                        vertex.Normal = attributes.normals[c.normal];
+                    mesh.vertices.push_back(vertex);
+                }
+                for(unsigned int v = first + 1; v + 1 < (unsigned int) mesh.vertices.size(); v++)
+                {
+                    mesh.indices.push_back(first);
+                    mesh.indices.push_back(v);
+                    mesh.indices.push_back(v + 1);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    static bool inRange(long long index, size_t size)
+    {
+        return index >= 0 && (size_t) index < size;
+    }
+};
+#endif
@@ -4,66 +4,97 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <cstdio>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <common.h>
+#include <AssetFileSystem.h>
+#include <ProgramBinaryCache.h>
+#include <Timer.h>
+
+// how a program was built at startup, reported by PrintShaderLoadReport
+struct ShaderLoadStats
+{
+    std::string name;
+    bool fromCache = false;
+    double milliseconds = 0.0;        // compiling and linking, or loading the binary
+    double compileMilliseconds = 0.0; // for a cached binary, what building it took when it was saved
+};
+
+// Uniform locations are looked up once: the active uniforms are read from the program after it is linked or loaded,
+// every location is kept in a hash table, and names the program doesn't have are remembered as -1 on the first
+// query. Location() hands out the location itself for the hot paths, the setters taking it are a plain GL call.
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // off, every setter taking a name asks the driver with glGetUniformLocation like before; for comparisons
+    static bool &CacheUniformLocations()
+    {
+        static bool cache = true;
+        return cache;
+    }
+    // glGetUniformLocation calls of all programs, for the per frame statistics
+    static size_t &LocationQueries()
+    {
+        static size_t queries = 0;
+        return queries;
+    }
+    // every program constructed so far, in order
+    static std::vector<ShaderLoadStats> &LoadStats()
+    {
+        static std::vector<ShaderLoadStats> stats;
+        return stats;
+    }
+    // constructor generates the shader on the fly, or loads it from the program binary cache. defines are #define
+    // lines put in front of every stage, right after its #version line, see ShaderVariants
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::string &defines = std::string())
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
 
         vertexPath = vertexPathString.c_str();
         fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
+        // 1. retrieve the vertex/fragment source code through the asset file system
+        AssetFile vShaderFile(vertexPath);
+        AssetFile fShaderFile(fragmentPath);
+        AssetFile gShaderFile;
+        // if geometry shader path is present, also load a geometry shader
+        if(geometryPath != nullptr)
+            gShaderFile.open(geometryPath);
+        if(!vShaderFile.isOpen() || !fShaderFile.isOpen() || (geometryPath != nullptr && !gShaderFile.isOpen()))
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        // the sources are small, a copy is simpler to hash and hand to glShaderSource than the spans
+        std::string vertexCode = injectDefines(vShaderFile.text(), defines);
+        std::string fragmentCode = injectDefines(fShaderFile.text(), defines);
+        std::string geometryCode = injectDefines(gShaderFile.text(), defines);
+        Timer timer;
+        ShaderLoadStats stats;
+        stats.name = vertexPathString.substr(0, vertexPathString.find_last_of('.'));
+        if(!defines.empty())
+            stats.name += " " + variantName(defines);
+        // the binary of exactly these sources, linked by this driver
+        std::vector<std::string> sources = {vertexCode, fragmentCode};
+        if(geometryPath != nullptr)
+            sources.push_back(geometryCode);
+        ProgramBinaryCache &cache = ProgramBinaryCache::Instance();
+        uint64_t key = cache.Key(sources);
+        ID = cache.LoadProgram(key, stats.compileMilliseconds);
+        if(ID != 0)
+        {
+            stats.fromCache = true;
+            reflectUniforms();
+            stats.milliseconds = timer.Milliseconds();
+            LoadStats().push_back(stats);
+            return;
         }
+
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
@@ -94,14 +125,21 @@ public:
         glAttachShader(ID, fragment);
         if(geometryPath != nullptr)
             glAttachShader(ID, geometry);
+        cache.PrepareToSave(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        bool linked = checkCompileErrors(ID, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
         if(geometryPath != nullptr)
             glDeleteShader(geometry);
 
+        if(linked)
+            reflectUniforms();
+        stats.milliseconds = stats.compileMilliseconds = timer.Milliseconds();
+        if(linked && cache.Supported() && !cache.Save(key, ID, stats.compileMilliseconds))
+            std::cout << "WARNING::SHADER:: failed to write the program binary of " << stats.name << std::endl;
+        LoadStats().push_back(stats);
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -109,69 +147,176 @@ public:
     { 
         glUseProgram(ID); 
     }
+    // location of a uniform, -1 when the program doesn't use it; stays valid for the lifetime of the program
+    // ------------------------------------------------------------------------
+    int Location(const std::string &name) const
+    {
+        if(!CacheUniformLocations())
+        {
+            LocationQueries()++;
+            return glGetUniformLocation(ID, name.c_str());
+        }
+        auto found = locations.find(name);
+        if(found != locations.end())
+            return found->second;
+        // elements past the first of an array of a basic type, or a name the program doesn't have
+        LocationQueries()++;
+        int location = glGetUniformLocation(ID, name.c_str());
+        locations.emplace(name, location);
+        return location;
+    }
+    // connects the uniform block of that name to a buffer binding point; false when the program has no such block
+    // ------------------------------------------------------------------------
+    bool BindUniformBlock(const std::string &name, unsigned int binding) const
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if(index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(ID, index, binding);
+        return true;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setBool(Location(name), value);
+    }
+    void setBool(int location, bool value) const
+    {
+        glUniform1i(location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(Location(name), value);
+    }
+    void setInt(int location, int value) const
+    {
+        glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(Location(name), value);
+    }
+    void setFloat(int location, float value) const
+    {
+        glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec2(Location(name), value);
+    }
+    void setVec2(int location, const glm::vec2 &value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(Location(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec3(Location(name), value);
+    }
+    void setVec3(int location, const glm::vec3 &value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(Location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec4(Location(name), value);
+    }
+    void setVec4(int location, const glm::vec4 &value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(Location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(Location(name), mat);
+    }
+    void setMat4(int location, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // filled from the program's active uniforms, and by Location() with the names it had to ask the driver for
+    mutable std::unordered_map<std::string, int> locations;
+
+    // reads the location of every active uniform; an array is reported by the name of its first element, it is
+    // also stored under the bare name, "lights[0]" as "lights"
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> name(maxLength > 0 ? maxLength : 1);
+        locations.clear();
+        locations.reserve(count * 2);
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            std::string uniformName(name.data(), length);
+            LocationQueries()++;
+            int location = glGetUniformLocation(ID, uniformName.c_str());
+            // uniforms of named blocks have no location
+            if(location < 0)
+                continue;
+            locations[uniformName] = location;
+            if(uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+                locations[uniformName.substr(0, uniformName.size() - 3)] = location;
+        }
+    }
+
+    static std::string injectDefines(const std::string &source, const std::string &defines)
+    {
+        size_t versionEnd = source.find('\n');
+        if(defines.empty() || versionEnd == std::string::npos)
+            return source;
+        // #line keeps the line numbers of compile errors those of the file
+        return source.substr(0, versionEnd + 1) + defines + "#line 2\n" + source.substr(versionEnd + 1);
+    }
+
+    // "#define BLINN 1\n#define BLENDED 0\n" as "BLINN=1 BLENDED=0", for the load report
+    static std::string variantName(const std::string &defines)
+    {
+        std::string name;
+        std::istringstream lines(defines);
+        std::string directive, macro, value;
+        while(lines >> directive >> macro >> value)
+            name += (name.empty() ? "" : " ") + macro + "=" + value;
+        return name;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +338,36 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
+
+// prints how every program was built, with the compile time a cached binary saved next to its load time
+void PrintShaderLoadReport()
+{
+    // compiling only counts the programs built in this run, the compile times saved with cached binaries are
+    // what loading them avoided
+    double total = 0.0, compiling = 0.0, avoided = 0.0;
+    size_t cached = 0;
+    std::cout << "Shader programs:" << std::endl;
+    for(const ShaderLoadStats &stats : Shader::LoadStats())
+    {
+        if(stats.fromCache)
+        {
+            printf("  %-40s binary   %8.2f ms (compiling took %.2f ms)\n", stats.name.c_str(), stats.milliseconds,
+                   stats.compileMilliseconds);
+            avoided += stats.compileMilliseconds;
+            cached++;
+        }
+        else
+        {
+            printf("  %-40s compiled %8.2f ms\n", stats.name.c_str(), stats.milliseconds);
+            compiling += stats.milliseconds;
+        }
+        total += stats.milliseconds;
+    }
+    printf("  total %.2f ms, %.2f ms compiling from source\n", total, compiling);
+    if(cached > 0)
+        printf("  %zu programs from cached binaries, compiling them took %.2f ms when they were saved\n", cached, avoided);
+}
 #endif
@@ -0,0 +1,64 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader.h>
+#include <common.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// One permutation of a program: the #define lines compiled into it and a key naming it. Built once, up front; at
+// draw time only the key is looked at.
+struct ShaderVariant
+{
+    uint64_t key = 14695981039346656037ull;
+    std::string defines;
+
+    ShaderVariant &Define(const std::string &name, int value)
+    {
+        std::string line = "#define " + name + " " + std::to_string(value) + "\n";
+        defines += line;
+        key = fnv1a64(line, key);
+        return *this;
+    }
+};
+
+// The permutations of one program, compiled from the same files with different #defines so that every branch a
+// variant doesn't need is gone at compile time. A variant is built the first time it is asked for and kept; each
+// also lands in the program binary cache under the hash of its sources. configure runs once on every new program,
+// for block bindings and uniforms that never change.
+class ShaderVariants
+{
+public:
+    ShaderVariants(std::string vertexPath, std::string fragmentPath, std::function<void(Shader &)> configure = nullptr)
+        : vertexPath(std::move(vertexPath)), fragmentPath(std::move(fragmentPath)), configure(std::move(configure))
+    {
+    }
+
+    Shader &Get(const ShaderVariant &variant)
+    {
+        std::unique_ptr<Shader> &program = programs[variant.key];
+        if(!program)
+        {
+            program.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), nullptr, variant.defines));
+            if(configure)
+                configure(*program);
+        }
+        return *program;
+    }
+
+    size_t Count() const
+    {
+        return programs.size();
+    }
+
+private:
+    std::string vertexPath, fragmentPath;
+    std::function<void(Shader &)> configure;
+    std::unordered_map<uint64_t, std::unique_ptr<Shader>> programs;
+};
+
+#endif
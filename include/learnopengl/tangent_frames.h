@@ -0,0 +1,238 @@
+#ifndef TANGENT_FRAMES_H
+#define TANGENT_FRAMES_H
+
+#include <learnopengl/mesh.h>
+#include <ThreadPool.h>
+#include <common.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+// Smooth normals and tangent frames for imported meshes, in place of aiProcess_GenSmoothNormals and
+// aiProcess_CalcTangentSpace which run on a single core.
+//
+//   1. vertices are grouped: by position for normals, by position, normal and texture coordinates for tangents
+//   2. per triangle values (area weighted normal, UV tangent and bitangent) are computed over blocks of triangles
+//   3. every group sums the values of its triangles, in triangle order, and writes the result to its vertices
+// The triangles of a group are visited in the same order however the work is split, so the output is bit identical
+// for any number of threads. Step 1 is the only serial part, a single hash table pass over the vertices.
+
+// four float lanes holding x, y, z and 0, on SSE2 when the compiler targets it
+struct FrameVector {
+#if defined(__SSE2__)
+    __m128 v;
+
+    static FrameVector Load(const glm::vec3 &p) { return FrameVector{_mm_set_ps(0.0f, p.z, p.y, p.x)}; }
+    static FrameVector Zero() { return FrameVector{_mm_setzero_ps()}; }
+    FrameVector operator+(FrameVector o) const { return FrameVector{_mm_add_ps(v, o.v)}; }
+    FrameVector operator-(FrameVector o) const { return FrameVector{_mm_sub_ps(v, o.v)}; }
+    FrameVector operator*(float s) const { return FrameVector{_mm_mul_ps(v, _mm_set1_ps(s))}; }
+    float Dot(FrameVector o) const
+    {
+        float lanes[4];
+        _mm_storeu_ps(lanes, _mm_mul_ps(v, o.v));
+        return (lanes[0] + lanes[1]) + lanes[2];
+    }
+    FrameVector Cross(FrameVector o) const
+    {
+        // (a.yzx * b.zxy) - (a.zxy * b.yzx)
+        __m128 a1 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1)), b1 = _mm_shuffle_ps(o.v, o.v, _MM_SHUFFLE(3, 1, 0, 2));
+        __m128 a2 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 2)), b2 = _mm_shuffle_ps(o.v, o.v, _MM_SHUFFLE(3, 0, 2, 1));
+        return FrameVector{_mm_sub_ps(_mm_mul_ps(a1, b1), _mm_mul_ps(a2, b2))};
+    }
+    glm::vec3 Store() const
+    {
+        float lanes[4];
+        _mm_storeu_ps(lanes, v);
+        return glm::vec3(lanes[0], lanes[1], lanes[2]);
+    }
+#else
+    float x, y, z;
+
+    static FrameVector Load(const glm::vec3 &p) { return FrameVector{p.x, p.y, p.z}; }
+    static FrameVector Zero() { return FrameVector{0.0f, 0.0f, 0.0f}; }
+    FrameVector operator+(FrameVector o) const { return FrameVector{x + o.x, y + o.y, z + o.z}; }
+    FrameVector operator-(FrameVector o) const { return FrameVector{x - o.x, y - o.y, z - o.z}; }
+    FrameVector operator*(float s) const { return FrameVector{x * s, y * s, z * s}; }
+    float Dot(FrameVector o) const { return (x * o.x + y * o.y) + z * o.z; }
+    FrameVector Cross(FrameVector o) const { return FrameVector{y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x}; }
+    glm::vec3 Store() const { return glm::vec3(x, y, z); }
+#endif
+
+    // unit length, or fallback when the vector is zero
+    FrameVector Normalized(FrameVector fallback) const
+    {
+        float length = std::sqrt(Dot(*this));
+        return length > 1e-20f ? *this * (1.0f / length) : fallback;
+    }
+};
+
+// triangles are handed out to the pool in blocks of this many
+const size_t TANGENT_FRAME_BLOCK = 8192;
+
+// Assigns every vertex the index of the first vertex with the same key bytes, the group representative.
+// keyBytes returns the address of a vertex's key, which has keySize bytes.
+template<typename KeyBytes>
+void groupVertices(size_t vertexCount, size_t keySize, KeyBytes keyBytes, vector<unsigned int> &group)
+{
+    size_t capacity = 16;
+    while(capacity < vertexCount * 2)
+        capacity *= 2;
+    const unsigned int empty = ~0u;
+    vector<unsigned int> table(capacity, empty);
+    group.resize(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+    {
+        const void *key = keyBytes(v);
+        size_t slot = (size_t) fnv1a64(key, keySize) & (capacity - 1);
+        while(table[slot] != empty && memcmp(keyBytes(table[slot]), key, keySize) != 0)
+            slot = (slot + 1) & (capacity - 1);
+        if(table[slot] == empty)
+            table[slot] = (unsigned int) v;
+        group[v] = table[slot];
+    }
+}
+
+// the triangles around each group representative as compressed rows, in triangle order
+void groupTriangles(const vector<unsigned int> &indices, const vector<unsigned int> &group,
+                    vector<unsigned int> &offsets, vector<unsigned int> &triangles)
+{
+    offsets.assign(group.size() + 1, 0);
+    for(unsigned int index : indices)
+        offsets[group[index] + 1]++;
+    for(size_t v = 0; v < group.size(); v++)
+        offsets[v + 1] += offsets[v];
+    triangles.resize(indices.size());
+    vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < indices.size(); i++)
+        triangles[fill[group[indices[i]]]++] = (unsigned int) (i / 3);
+}
+
+// smooth, area weighted normals for the vertices whose normal is zero, other vertices keep theirs
+void generateNormals(vector<Vertex> &vertices, const vector<unsigned int> &indices, ThreadPool &pool)
+{
+    size_t triangleCount = indices.size() / 3;
+    vector<unsigned int> group, offsets, triangles;
+    groupVertices(vertices.size(), sizeof(glm::vec3), [&](size_t v) { return &vertices[v].Position; }, group);
+    groupTriangles(indices, group, offsets, triangles);
+
+    vector<FrameVector> faceNormals(triangleCount);
+    pool.ParallelFor((triangleCount + TANGENT_FRAME_BLOCK - 1) / TANGENT_FRAME_BLOCK, [&](size_t block)
+    {
+        size_t end = std::min(triangleCount, (block + 1) * TANGENT_FRAME_BLOCK);
+        for(size_t t = block * TANGENT_FRAME_BLOCK; t < end; t++)
+        {
+            FrameVector p0 = FrameVector::Load(vertices[indices[t * 3]].Position);
+            FrameVector p1 = FrameVector::Load(vertices[indices[t * 3 + 1]].Position);
+            FrameVector p2 = FrameVector::Load(vertices[indices[t * 3 + 2]].Position);
+            faceNormals[t] = (p1 - p0).Cross(p2 - p0);
+        }
+    });
+
+    pool.ParallelFor((vertices.size() + TANGENT_FRAME_BLOCK - 1) / TANGENT_FRAME_BLOCK, [&](size_t block)
+    {
+        size_t end = std::min(vertices.size(), (block + 1) * TANGENT_FRAME_BLOCK);
+        for(size_t v = block * TANGENT_FRAME_BLOCK; v < end; v++)
+        {
+            if(vertices[v].Normal != glm::vec3(0.0f))
+                continue;
+            unsigned int representative = group[v];
+            FrameVector sum = FrameVector::Zero();
+            for(unsigned int a = offsets[representative]; a < offsets[representative + 1]; a++)
+                sum = sum + faceNormals[triangles[a]];
+            vertices[v].Normal = sum.Normalized(FrameVector::Zero()).Store();
+        }
+    });
+}
+
+// tangent (along +U) and bitangent (along +V) orthogonal to the normal, summed over the triangles sharing the
+// vertex's position, normal and texture coordinates, so UV seams and mirrored halves keep separate frames
+void generateTangents(vector<Vertex> &vertices, const vector<unsigned int> &indices, ThreadPool &pool)
+{
+    size_t triangleCount = indices.size() / 3;
+    // Position, Normal and TexCoords are adjacent in Vertex
+    const size_t keySize = offsetof(Vertex, Tangent) - offsetof(Vertex, Position);
+    vector<unsigned int> group, offsets, triangles;
+    groupVertices(vertices.size(), keySize, [&](size_t v) { return &vertices[v].Position; }, group);
+    groupTriangles(indices, group, offsets, triangles);
+
+    // the UV gradients of every triangle, scaled by the sign of the UV area only, so larger triangles weigh more
+    vector<FrameVector> faceTangents(triangleCount), faceBitangents(triangleCount);
+    pool.ParallelFor((triangleCount + TANGENT_FRAME_BLOCK - 1) / TANGENT_FRAME_BLOCK, [&](size_t block)
+    {
+        size_t end = std::min(triangleCount, (block + 1) * TANGENT_FRAME_BLOCK);
+        for(size_t t = block * TANGENT_FRAME_BLOCK; t < end; t++)
+        {
+            const Vertex &v0 = vertices[indices[t * 3]], &v1 = vertices[indices[t * 3 + 1]], &v2 = vertices[indices[t * 3 + 2]];
+            FrameVector e1 = FrameVector::Load(v1.Position) - FrameVector::Load(v0.Position);
+            FrameVector e2 = FrameVector::Load(v2.Position) - FrameVector::Load(v0.Position);
+            glm::vec2 uv1 = v1.TexCoords - v0.TexCoords, uv2 = v2.TexCoords - v0.TexCoords;
+            float determinant = uv1.x * uv2.y - uv2.x * uv1.y;
+            if(determinant == 0.0f)
+            {
+                faceTangents[t] = faceBitangents[t] = FrameVector::Zero();
+                continue;
+            }
+            float sign = determinant < 0.0f ? -1.0f : 1.0f;
+            faceTangents[t] = (e1 * uv2.y - e2 * uv1.y) * sign;
+            faceBitangents[t] = (e2 * uv1.x - e1 * uv2.x) * sign;
+        }
+    });
+
+    pool.ParallelFor((vertices.size() + TANGENT_FRAME_BLOCK - 1) / TANGENT_FRAME_BLOCK, [&](size_t block)
+    {
+        size_t end = std::min(vertices.size(), (block + 1) * TANGENT_FRAME_BLOCK);
+        for(size_t v = block * TANGENT_FRAME_BLOCK; v < end; v++)
+        {
+            unsigned int representative = group[v];
+            FrameVector tangent = FrameVector::Zero(), bitangent = FrameVector::Zero();
+            for(unsigned int a = offsets[representative]; a < offsets[representative + 1]; a++)
+            {
+                tangent = tangent + faceTangents[triangles[a]];
+                bitangent = bitangent + faceBitangents[triangles[a]];
+            }
+            // Gram-Schmidt against the normal; degenerate UVs get any frame around the normal
+            FrameVector normal = FrameVector::Load(vertices[v].Normal);
+            glm::vec3 n = vertices[v].Normal;
+            FrameVector axis = FrameVector::Load(std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+            FrameVector fallbackTangent = normal.Cross(axis).Normalized(axis);
+            tangent = (tangent - normal * normal.Dot(tangent)).Normalized(fallbackTangent);
+            bitangent = (bitangent - normal * normal.Dot(bitangent)).Normalized(normal.Cross(tangent));
+            vertices[v].Tangent = tangent.Store();
+            vertices[v].Bitangent = bitangent.Store();
+        }
+    });
+}
+
+// Fills in the normals the mesh is missing (zero) and, when it has texture coordinates, the tangents and
+// bitangents of all vertices. Expects unwelded or welded triangle lists alike; runs before WeldVertices so
+// corners that end up with equal frames get merged.
+void GenerateTangentFrames(MeshData &mesh, ThreadPool &pool = ThreadPool::Shared())
+{
+    vector<Vertex> &vertices = mesh.vertices;
+    const vector<unsigned int> &indices = mesh.indices;
+    if(vertices.empty() || indices.size() < 3 || indices.size() % 3 != 0 || vertices.size() > 0xffffffffu / 2)
+        return;
+
+    bool missingNormals = false, hasTexCoords = false;
+    for(const Vertex &vertex : vertices)
+    {
+        missingNormals |= vertex.Normal == glm::vec3(0.0f);
+        hasTexCoords |= vertex.TexCoords != glm::vec2(0.0f);
+    }
+    if(missingNormals)
+        generateNormals(vertices, indices, pool);
+    if(hasTexCoords)
+        generateTangents(vertices, indices, pool);
+}
+#endif
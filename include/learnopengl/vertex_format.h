@@ -0,0 +1,127 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <learnopengl/mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+// snorm 10-10-10-2 as read by GL_INT_2_10_10_10_REV with normalization on; x in the lowest bits
+uint32_t PackSnorm1010102(glm::vec3 value, float w)
+{
+    uint32_t packed = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        int component = (int) std::lround(std::min(std::max(value[i], -1.0f), 1.0f) * 511.0f);
+        packed |= ((uint32_t) component & 0x3ffu) << (10 * i);
+    }
+    // only the sign of w is used, +1 or -1 in two bits
+    packed |= (w < 0.0f ? 0x3u : 0x1u) << 30;
+    return packed;
+}
+
+// IEEE 754 binary16 with round to nearest even
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int exponent = (int) ((bits >> 23) & 0xffu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if((bits & 0x7fffffffu) > 0x7f800000u)
+        return (uint16_t) (sign | 0x7e00u); // NaN
+    if(exponent >= 31)
+        return (uint16_t) (sign | 0x7c00u); // too large, infinity
+    if(exponent <= 0)
+    {
+        // subnormal half or zero
+        if(exponent < -10)
+            return (uint16_t) sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t) (14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if(remainder > halfway || (remainder == halfway && (half & 1u)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fffu;
+    // a carry out of the mantissa correctly bumps the exponent
+    if(remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        half++;
+    return (uint16_t) half;
+}
+
+// -1 when the bitangent points against cross(normal, tangent), which happens for mirrored UVs
+float BitangentSign(const Vertex &vertex)
+{
+    return glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+}
+
+// builds the GPU layout of the requested format from the float vertices of the mesh
+void PackVertices(MeshData &mesh, VertexFormat format)
+{
+    mesh.format = format;
+    mesh.packedVertices.clear();
+    mesh.quantization = PositionQuantization();
+    if(format == VERTEX_FORMAT_FLOAT)
+        return;
+
+    const vector<Vertex> &vertices = mesh.vertices;
+    mesh.packedVertices.resize(vertices.size() * VertexStride(format));
+
+    if(format == VERTEX_FORMAT_PACKED)
+    {
+        PackedVertex *packed = reinterpret_cast<PackedVertex *>(mesh.packedVertices.data());
+        for(size_t i = 0; i < vertices.size(); i++)
+        {
+            packed[i].Position = vertices[i].Position;
+            packed[i].Normal = PackSnorm1010102(vertices[i].Normal, 1.0f);
+            packed[i].Tangent = PackSnorm1010102(vertices[i].Tangent, BitangentSign(vertices[i]));
+            packed[i].TexCoords[0] = FloatToHalf(vertices[i].TexCoords.x);
+            packed[i].TexCoords[1] = FloatToHalf(vertices[i].TexCoords.y);
+        }
+        return;
+    }
+
+    // positions are stored relative to the bounds of the mesh
+    glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+    if(!vertices.empty())
+    {
+        boundsMin = boundsMax = vertices[0].Position;
+        for(const Vertex &vertex : vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.Position);
+            boundsMax = glm::max(boundsMax, vertex.Position);
+        }
+    }
+    glm::vec3 extent = boundsMax - boundsMin;
+    for(int i = 0; i < 3; i++)
+        if(extent[i] <= 0.0f)
+            extent[i] = 1.0f;
+    mesh.quantization.offset = boundsMin;
+    mesh.quantization.scale = extent;
+
+    PackedVertexPositions16 *packed = reinterpret_cast<PackedVertexPositions16 *>(mesh.packedVertices.data());
+    for(size_t i = 0; i < vertices.size(); i++)
+    {
+        glm::vec3 normalized = (vertices[i].Position - boundsMin) / extent;
+        for(int c = 0; c < 3; c++)
+            packed[i].Position[c] = (uint16_t) std::lround(std::min(std::max(normalized[c], 0.0f), 1.0f) * 65535.0f);
+        packed[i].Position[3] = 0;
+        packed[i].Normal = PackSnorm1010102(vertices[i].Normal, 1.0f);
+        packed[i].Tangent = PackSnorm1010102(vertices[i].Tangent, BitangentSign(vertices[i]));
+        packed[i].TexCoords[0] = FloatToHalf(vertices[i].TexCoords.x);
+        packed[i].TexCoords[1] = FloatToHalf(vertices[i].TexCoords.y);
+    }
+}
+#endif
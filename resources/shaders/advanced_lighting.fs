@@ -1,42 +1,40 @@
 #version 330 core
 out vec4 FragColor;
 
-struct DirLight {
-    vec3 direction;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct PointLight {
-    vec3 position;
-
-    float constant;
-    float linear;
-    float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-};
-
-struct SpotLight {
+// the variant, #defined by ShaderVariants in front of the source; without them this is the full lighting model
+#ifndef BLINN
+#define BLINN 1          // Blinn-Phong highlights, Phong otherwise
+#endif
+#ifndef BLENDED
+#define BLENDED 0        // the alpha of the lighting is kept, opaque surfaces write 1
+#endif
+#ifndef SPECULAR_MAP
+#define SPECULAR_MAP 1   // without one the red channel of the diffuse map is the specular intensity
+#endif
+#ifndef CLUSTERED
+#define CLUSTERED 0      // only the lights LightClusters listed for the fragment's cluster, instead of the Lights block
+#endif
+
+#define LIGHT_DIRECTIONAL 0
+#define LIGHT_POINT 1
+#define LIGHT_SPOT 2
+
+// every kind of light in one struct, the members a type doesn't use are ignored. Ordered so every scalar fills the
+// rest of the vec3 before it in the std140 layout, mirrored by LightBlock in UniformBlocks.h
+struct Light {
     vec3 position;
+    int type;
     vec3 direction;
     float cutOff;
+    vec3 ambient;
     float outerCutOff;
-
+    vec3 diffuse;
     float constant;
+    vec3 specular;
     float linear;
     float quadratic;
-
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
 };
 
-
 in VS_OUT {
     vec3 FragPos;
     vec3 Normal;
@@ -49,163 +47,145 @@ struct Material {
 };
 
 uniform Material material;
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform bool blinn;
-uniform int blending;
 
 //-----------------
 
-#define SPOT_LIGHTS_AMOUNT 4
-
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLights[SPOT_LIGHTS_AMOUNT];
-
-vec4 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
-vec4 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec4 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-
-void main()
-{
-    vec3 normal = normalize(fs_in.Normal);
-    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
-
-    FragColor = CalcDirLight(dirLight, normal, viewDir);
-
-
-    FragColor += CalcPointLight(pointLight, normal, fs_in.FragPos, viewDir);
+#define MAX_LIGHTS 16
 
+// declared like in the vertex shader, for viewPos
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    mat4 skyboxView;
+    vec3 viewPos;
+};
 
-    for(int i=0; i < SPOT_LIGHTS_AMOUNT; i++)
-        FragColor += CalcSpotLight(spotLights[i], normal, fs_in.FragPos, viewDir);
+#if CLUSTERED
+// the lights as rows of six texels, laid out like LightBlock
+uniform samplerBuffer lightData;
+// per cluster the offset of its list in clusterLights and its length
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLights;
 
-}
+layout (std140) uniform Clusters {
+    uvec4 clusterSize;    // tiles across, tiles down, depth slices, and the global lights at the start of lightData
+    vec4 clusterSlicing;  // slice = log(depth) * x + y, tile width and height in pixels
+};
 
-vec4 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+Light FetchLight(int index)
 {
-        vec4 diffuseColor = texture(material.diffuseMap, fs_in.TexCoords).rgba;
-        vec4 specularColor = vec4(texture(material.specularMap, fs_in.TexCoords).rrr, 1);
-        vec3 lightDir = normalize(-light.direction);
-
-        // ambient
-        vec4 ambient = vec4(light.ambient, 1.0) * diffuseColor;
-
-        // diffuse
-        float diff = max(dot(lightDir, normal), 0.0);
-        vec4 diffuse = vec4(light.diffuse, 1.0) * diff * diffuseColor;
+    int texel = index * 6;
+    vec4 row0 = texelFetch(lightData, texel);
+    vec4 row1 = texelFetch(lightData, texel + 1);
+    vec4 row2 = texelFetch(lightData, texel + 2);
+    vec4 row3 = texelFetch(lightData, texel + 3);
+    vec4 row4 = texelFetch(lightData, texel + 4);
+    Light light;
+    light.position = row0.xyz;
+    light.type = floatBitsToInt(row0.w);
+    light.direction = row1.xyz;
+    light.cutOff = row1.w;
+    light.ambient = row2.xyz;
+    light.outerCutOff = row2.w;
+    light.diffuse = row3.xyz;
+    light.constant = row3.w;
+    light.specular = row4.xyz;
+    light.linear = row4.w;
+    light.quadratic = texelFetch(lightData, texel + 5).x;
+    return light;
+}
+#else
+// the scene's lights, uploaded when they change
+layout (std140) uniform Lights {
+    int lightCount;
+    Light lights[MAX_LIGHTS];
+};
+#endif
 
-        // specular
-        vec3 reflectDir = reflect(-lightDir, normal);
-        float spec = 0.0;
-        if(blinn)
-        {
-            vec3 halfwayDir = normalize(lightDir + viewDir);
-            spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-        }
-        else
-        {
-            vec3 reflectDir = reflect(-lightDir, normal);
-            spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
-        }
-        vec4 specular = vec4(light.specular, 1) * spec * specularColor; // assuming bright white light color
+// the sums over the lights
+vec3 ambient = vec3(0.0), diffuse = vec3(0.0), specular = vec3(0.0);
+float alpha = 0.0;
 
-        vec4 result = ambient + diffuse + specular;
+float CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir);
+void AddLight(Light light, vec3 normal, vec3 viewDir, float diffuseAlpha);
 
-        if(blending == 0)
-            result.w = 1.0;
+void main()
+{
+    vec3 normal = normalize(fs_in.Normal);
+    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
 
-       return result;
+    // the material is sampled once, every light shades with the same two values
+    vec4 diffuseColor = texture(material.diffuseMap, fs_in.TexCoords);
+#if SPECULAR_MAP
+    float specularIntensity = texture(material.specularMap, fs_in.TexCoords).r;
+#else
+    float specularIntensity = diffuseColor.r;
+#endif
+
+#if CLUSTERED
+    for(int i = 0; i < int(clusterSize.w); i++)
+        AddLight(FetchLight(i), normal, viewDir, diffuseColor.a);
+
+    float depth = max(-(view * vec4(fs_in.FragPos, 1.0)).z, 1e-4);
+    uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy / clusterSlicing.zw),
+                          uint(max(log(depth) * clusterSlicing.x + clusterSlicing.y, 0.0)));
+    cluster = min(cluster, clusterSize.xyz - 1u);
+    uvec2 list = texelFetch(clusterGrid, int(cluster.x + clusterSize.x * (cluster.y + clusterSize.y * cluster.z))).rg;
+    for(uint i = 0u; i < list.y; i++)
+        AddLight(FetchLight(int(texelFetch(clusterLights, int(list.x + i)).r)), normal, viewDir, diffuseColor.a);
+#else
+    for(int i = 0; i < lightCount; i++)
+        AddLight(lights[i], normal, viewDir, diffuseColor.a);
+#endif
+
+    FragColor.rgb = (ambient + diffuse) * diffuseColor.rgb + specular * specularIntensity;
+#if BLENDED
+    FragColor.a = alpha;
+#else
+    FragColor.a = 1.0;
+#endif
 }
 
-vec4 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+float CalcSpecular(vec3 lightDir, vec3 normal, vec3 viewDir)
 {
-    vec4 diffuseColor = texture(material.diffuseMap, fs_in.TexCoords).rgba;
-    vec4 specularColor = vec4(texture(material.specularMap, fs_in.TexCoords).rrr, 0.5);
-    vec3 lightDir = normalize(light.position - fragPos);
-
-    // ambient
-    vec4 ambient = vec4(light.ambient, 1.0) * diffuseColor;
-
-    // diffuse
-    float diff = max(dot(lightDir, normal), 0.0);
-    vec4 diffuse = vec4(light.diffuse, 1.0) * diff * diffuseColor;
-
-    // specular
+#if BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    return pow(max(dot(normal, halfwayDir), 0.0), 32.0);
+#else
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = 0.0;
-    if(blinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
-    }
-    vec4 specular = vec4(light.specular, 0.5) * spec * specularColor; // assuming bright white light color
-
-    // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-
-    vec4 result = ambient + diffuse + specular;
-
-
-    return result;
+    return pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
+#endif
 }
 
-vec4 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+void AddLight(Light light, vec3 normal, vec3 viewDir, float diffuseAlpha)
 {
-        vec4 diffuseColor = texture(material.diffuseMap, fs_in.TexCoords).rgba;
-        vec4 specularColor = vec4(texture(material.specularMap, fs_in.TexCoords).rrr, 1);
-        vec3 lightDir = normalize(light.position - fragPos);
-
-        // ambient
-        vec4 ambient = vec4(light.ambient, 1.0) * diffuseColor;
-
-        // diffuse
-        float diff = max(dot(lightDir, normal), 0.0);
-        vec4 diffuse = vec4(light.diffuse, 1.0) * diff * diffuseColor;
-
-        // specular
-        vec3 reflectDir = reflect(-lightDir, normal);
-        float spec = 0.0;
-        if(blinn)
-        {
-            vec3 halfwayDir = normalize(lightDir + viewDir);
-            spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
-        }
-        else
+    vec3 lightDir;
+    float strength = 1.0;
+    if(light.type == LIGHT_DIRECTIONAL)
+        lightDir = normalize(-light.direction);
+    else
+    {
+        vec3 toLight = light.position - fs_in.FragPos;
+        float distance = length(toLight);
+        lightDir = toLight / distance;
+        if(light.type == LIGHT_SPOT)
         {
-            vec3 reflectDir = reflect(-lightDir, normal);
-            spec = pow(max(dot(viewDir, reflectDir), 0.0), 8.0);
+            float theta = dot(lightDir, normalize(-light.direction));
+            float epsilon = light.cutOff - light.outerCutOff;
+            strength = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+            // outside the cone a spot light adds nothing, not even ambient
+            if(strength <= 0.0)
+                return;
         }
-        vec4 specular = vec4(light.specular, 1) * spec * specularColor; // assuming bright white light color
-
-        // attenuation
-        float distance = length(light.position - fragPos);
-        float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-
-        //spotlight intensity
-        float theta = dot(lightDir, normalize(-light.direction));
-        float epsilon = light.cutOff - light.outerCutOff;
-        float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-
-
-        ambient *= attenuation * intensity;
-        diffuse *= attenuation * intensity;
-        specular *= attenuation * intensity;
-
-
-        vec4 result = ambient + diffuse + specular;
-
-
-        return result;
+        strength /= light.constant + light.linear * distance + light.quadratic * (distance * distance);
+    }
 
-}
\ No newline at end of file
+    float diff = max(dot(lightDir, normal), 0.0);
+    float spec = CalcSpecular(lightDir, normal, viewDir);
+    ambient += light.ambient * strength;
+    diffuse += light.diffuse * (diff * strength);
+    specular += light.specular * (spec * strength);
+    // what the glass has always been blended with: the point light's highlight counts a quarter
+    float specularAlpha = light.type == LIGHT_POINT ? 0.25 : 1.0;
+    alpha += (diffuseAlpha * (1.0 + diff) + specularAlpha * spec) * strength;
+}
@@ -10,15 +10,28 @@ out VS_OUT {
     vec2 TexCoords;
 } vs_out;
 
-uniform mat4 projection;
-uniform mat4 view;
+// shared by every program, filled once per frame from CameraBlock in UniformBlocks.h
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    mat4 skyboxView;
+    vec3 viewPos;
+};
+
 uniform mat4 model;
 
+// meshes in the quantized layout store positions as unorm16 inside their bounds,
+// normals and texture coordinates arrive already decoded through normalized/half float attributes
+uniform bool quantizedPosition;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 void main()
 {
-    vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 position = quantizedPosition ? positionOffset + positionScale * aPos : aPos;
+    vs_out.FragPos = vec3(model * vec4(position, 1.0));
     vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
     vs_out.TexCoords = aTexCoords;
 
     gl_Position = projection * view * vec4(vs_out.FragPos, 1.0);
-}
\ No newline at end of file
+}
@@ -13,9 +13,15 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <AssetFileSystem.h>
+#include <LightClusters.h>
+#include <Timer.h>
+#include <UniformBlocks.h>
 
+#include <algorithm>
 #include <iostream>
 
 #include <Cube.h>
@@ -30,9 +36,18 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
+ShaderVariant LightingVariant(bool blended, bool specularMap, bool clustered);
+
+void AddStressLights(vector<LightBlock> &lights, int count, float time);
+
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const size_t TEXTURE_UPLOAD_BUDGET = 8 * 1024 * 1024;
+const unsigned int FRAME_STATS_FRAMES = 60;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+const int MAX_STRESS_LIGHTS = 1024;
 
 // camera
 
@@ -67,6 +82,17 @@ struct ProgramState {
     glm::vec3 backpackPosition = glm::vec3(0.0f);
     float backpackScale = 1.0f;
     SpotLight spotLight;
+    // averages over the last FRAME_STATS_FRAMES frames: CPU time from the start of a frame to the buffer swap, and
+    // the glGetUniformLocation calls made in it
+    float frameCpuMilliseconds = 0.0f;
+    float locationQueriesPerFrame = 0.0f;
+    // read from /proc and getrusage at the same cadence, not every frame
+    size_t residentBytes = 0;
+    size_t peakBytes = 0;
+    // lights from the clusters instead of the Lights block, and how many extra small lights to scatter over the floor
+    bool clusteredLighting = true;
+    int stressLights = 0;
+    LightClusters::Stats clusterStats;
 
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
@@ -111,6 +137,12 @@ ProgramState *programState;
 void DrawImGui(ProgramState *programState);
 
 int main() {
+    // startup is timed up to the first frame and until every texture is resident with all its mips
+    Timer startupTimer;
+    // every loader reads through the asset file system, out of the resource pack where it has the asset
+    if (AssetFileSystem::Instance().Mount(AssetFileSystem::DefaultPackPath()))
+        printf("Resource pack: %zu assets, %.2f MB mapped\n", AssetFileSystem::Instance().Pack().Size(),
+               AssetFileSystem::Instance().Pack().Bytes() / 1048576.0);
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -144,9 +176,14 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // linked programs are kept as driver binaries between runs where the driver supports it
+    ProgramBinaryCache::Instance().LoadEntryPoints((GLADloadproc) glfwGetProcAddress);
+    // buffers and textures get created on a loader thread from here on, the render loop doesn't wait for them
+    if (!UploadContext::Instance().Start(window))
+        std::cout << "WARNING: no shared context for the loader thread, uploading on the main thread" << std::endl;
 
-    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    // tell the texture loader to flip loaded texture's on the y-axis (before loading model).
+    TextureLoader::FlipVertically() = true;
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -177,28 +214,63 @@ int main() {
 
     // build and compile shaders
     // -------------------------
-    Shader advancedLightingShader("resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs");
+    // every surface is lit by the advanced_lighting permutation made for its material
+    ShaderVariants advancedLighting("resources/shaders/advanced_lighting.vs", "resources/shaders/advanced_lighting.fs",
+                                    [](Shader &shader) {
+                                        shader.BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+                                        shader.BindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
+                                        LightClusters::Configure(shader);
+                                        shader.setInt("material.diffuseMap", 0);
+                                        shader.setInt("material.specularMap", 1);
+                                    });
+    // the clustered and the plain lighting are both built up front, the "Lights" window switches between them
+    struct LightingShaders {
+        Shader *opaque, *wall, *glass;
+        int model;
+    };
+    LightingShaders lightingShaders[2];
+    for (int clustered = 0; clustered < 2; clustered++) {
+        LightingShaders &shaders = lightingShaders[clustered];
+        shaders.opaque = &advancedLighting.Get(LightingVariant(false, true, clustered));
+        shaders.wall = &advancedLighting.Get(LightingVariant(false, false, clustered));
+        shaders.glass = &advancedLighting.Get(LightingVariant(true, true, clustered));
+        shaders.model = shaders.opaque->Location("model");
+    }
     Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
     Shader lightSource("resources/shaders/light_cube.vs", "resources/shaders/light_cube.fs");
+    PrintShaderLoadReport();
 
 
 
     // load models
     // -----------
-    Model moai("resources/objects/moai/moai.obj");
+    // parsing and post-processing run on the worker threads, the buffers are filled by the loader thread and each
+    // model is drawn from the first frame on which all of it is on the GPU
+    Timer modelLoadTimer;
+    // the scanned statues are bandwidth bound, they use the quantized vertex layout
+    ModelImportOptions scanOptions;
+    scanOptions.vertexFormat = VERTEX_FORMAT_PACKED_POSITIONS16;
+    scanOptions.lodLevels = 3;
+    // nothing in the scene reads geometry back, the GPU buffers are the only copy
+    scanOptions.cpuGeometry = CPU_GEOMETRY_RELEASE;
+    ModelImportOptions propOptions;
+    propOptions.cpuGeometry = CPU_GEOMETRY_RELEASE;
+
+    Model moai(Model::ImportAsync("resources/objects/moai/moai.obj", scanOptions));
     moai.SetShaderTextureNamePrefix("material.");
 
-    Model lucy("resources/objects/lucy/Stanford's Lucy Angel.obj");
+    Model lucy(Model::ImportAsync("resources/objects/lucy/Stanford's Lucy Angel.obj", scanOptions));
     lucy.SetShaderTextureNamePrefix("material.");
 
-    Model venus("resources/objects/venus/venus.obj");
+    Model venus(Model::ImportAsync("resources/objects/venus/venus.obj", scanOptions));
     venus.SetShaderTextureNamePrefix("material.");
 
-    Model spotlightObj("resources/objects/Spotlight.obj");
+    Model spotlightObj(Model::ImportAsync("resources/objects/Spotlight.obj", propOptions));
     spotlightObj.SetShaderTextureNamePrefix("material.");
 
-    Model ceilingLamp("resources/objects/CeilingLamp.obj");
+    Model ceilingLamp(Model::ImportAsync("resources/objects/CeilingLamp.obj", propOptions));
     ceilingLamp.SetShaderTextureNamePrefix("material.");
+    vector<Model *> models = {&moai, &lucy, &venus, &spotlightObj, &ceilingLamp};
 
 
 
@@ -234,8 +306,8 @@ int main() {
     unsigned int glassSpecularMap = loadTexture(FileSystem::getPath("resources/textures/glass_specular.png").c_str());
 
 
-    stbi_set_flip_vertically_on_load(false);
-    unsigned int cubemapTexture = loadCubemap(faces);
+    TextureLoader::FlipVertically() = false;
+    unsigned int cubemapTexture = loadCubemap(skyboxFaces());
 
 
     // shader configuration
@@ -251,51 +323,51 @@ int main() {
             {glm::vec3(0, 2.5f, -4.75f), glm::vec3(18.0f, 5.0f, 0.5f)}
     };
 
-    advancedLightingShader.use();
-    advancedLightingShader.setInt("blinn", 1);
+    // camera and lights reach the programs through the shared uniform blocks
+    for (Shader *shader : {&skyboxShader, &lightSource})
+        shader->BindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    UniformBuffer<CameraBlock> cameraBuffer;
+    UniformBuffer<LightsBlock> lightsBuffer;
+    cameraBuffer.Create(CAMERA_BLOCK_BINDING);
+    lightsBuffer.Create(LIGHTS_BLOCK_BINDING);
+    LightClusters lightClusters;
+    lightClusters.Create();
+    vector<LightBlock> sceneLights, frameLights;
 
     //Directional light
-    advancedLightingShader.setVec3("dirLight.direction", glm::vec3(-0.4, -0.5f, -0.075));
-    advancedLightingShader.setVec3("dirLight.ambient", glm::vec3(0.025f, 0.05f, 0.025f));
-    advancedLightingShader.setVec3("dirLight.diffuse", glm::vec3(0.075, 0.275, 0.175));
-    advancedLightingShader.setVec3("dirLight.specular", glm::vec3(0.05, 0.15, 0.05));
+    sceneLights.push_back(MakeDirectionalLight(glm::vec3(-0.4, -0.5f, -0.075), glm::vec3(0.025f, 0.05f, 0.025f),
+                                               glm::vec3(0.075, 0.275, 0.175), glm::vec3(0.05, 0.15, 0.05)));
 
     //Point light
-    advancedLightingShader.setVec3("pointLight.position", glm::vec3(-4, 4.2f, 0));
-    advancedLightingShader.setVec3("pointLight.ambient", glm::vec3(0.1f, 0.1f, 0.05f));
-    advancedLightingShader.setVec3("pointLight.diffuse", glm::vec3(0.4f, 0.35f, 0));
-    advancedLightingShader.setVec3("pointLight.specular", glm::vec3(0.5f, 0.3f, 0));
-    advancedLightingShader.setFloat("pointLight.constant", 1.0f);
-    advancedLightingShader.setFloat("pointLight.linear", 0.045f);
-    advancedLightingShader.setFloat("pointLight.quadratic", 0.0075f);
+    sceneLights.push_back(MakePointLight(glm::vec3(-4, 4.2f, 0), glm::vec3(0.1f, 0.1f, 0.05f), glm::vec3(0.4f, 0.35f, 0),
+                                         glm::vec3(0.5f, 0.3f, 0), 1.0f, 0.045f, 0.0075f));
 
 
 
 
     //Spotlights
-    advancedLightingShader.setVec3("spotLights[0].position", glm::vec3(8, 5.5f, -3));
-    advancedLightingShader.setVec3("spotLights[1].position", glm::vec3(8, 5.5f, 3));
-    advancedLightingShader.setVec3("spotLights[2].position", glm::vec3(8, 5.5f, 0));
-
-
-    for (int i = 0; i < 4; i++) {
-        string spotLightIt = "spotLights[" + to_string(i) + "]";
-        advancedLightingShader.setVec3(spotLightIt + ".direction", glm::vec3(0, -1, 0));
-        advancedLightingShader.setVec3(spotLightIt + ".ambient", glm::vec3(0.25f, 0.25f, 0.5f));
-        advancedLightingShader.setVec3(spotLightIt + ".diffuse", glm::vec3(1));
-        advancedLightingShader.setVec3(spotLightIt + ".specular", glm::vec3(1));
-        advancedLightingShader.setFloat(spotLightIt + ".constant", 1.0f);
-        advancedLightingShader.setFloat(spotLightIt + ".linear", 0.045f);
-        advancedLightingShader.setFloat(spotLightIt + ".quadratic", 0.0075f);
-        advancedLightingShader.setFloat(spotLightIt + ".cutOff", glm::cos(glm::radians(10.0f)));
-        advancedLightingShader.setFloat(spotLightIt + ".outerCutOff", glm::cos(glm::radians(25.0f)));
-    }
+    for (glm::vec3 position : {glm::vec3(8, 5.5f, -3), glm::vec3(8, 5.5f, 3), glm::vec3(8, 5.5f, 0)})
+        sceneLights.push_back(MakeSpotLight(position, glm::vec3(0, -1, 0), 10.0f, 25.0f, glm::vec3(0.25f, 0.25f, 0.5f),
+                                            glm::vec3(1), glm::vec3(1), 1.0f, 0.045f, 0.0075f));
+
 
 
+    // the uniforms set every frame, looked up once
+    const int lightSourceModel = lightSource.Location("model");
+    const int lightSourceColor = lightSource.Location("color");
 
     // render loop
     // -----------
+    bool steadyStateReported = false;
+    bool firstFrameReported = false;
+    bool modelsReported = false;
+    double frameCpuMilliseconds = 0.0;
+    unsigned int statsFrames = 0;
+    size_t statsLocationQueries = Shader::LocationQueries();
+    programState->residentBytes = currentResidentBytes();
+    programState->peakBytes = peakResidentBytes();
     while (!glfwWindowShouldClose(window)) {
+        Timer frameTimer;
         // per-frame time logic
         // --------------------
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -306,6 +378,39 @@ int main() {
         // -----
         processInput(window);
 
+        // hand over what the loader thread finished, then queue the next texture levels, a few MB per frame at most
+        UploadContext::Instance().Poll();
+        TextureLoader::Instance().Update(TEXTURE_UPLOAD_BUDGET);
+        if (!modelsReported && std::all_of(models.begin(), models.end(), [](Model *m) { return m->Ready(); })) {
+            PrintModelLoadReport(vector<const Model *>(models.begin(), models.end()), modelLoadTimer.Milliseconds());
+            printf("Memory after model loading: resident %.2f MB, peak %.2f MB\n", currentResidentBytes() / 1048576.0,
+                   peakResidentBytes() / 1048576.0);
+            modelsReported = true;
+        }
+        if (!steadyStateReported && modelsReported && TextureLoader::Instance().Pending() == 0) {
+            // everything is loaded and uploaded, memory should not grow from here on
+            printf("Textures fully resident after %.1f ms\n", startupTimer.Milliseconds());
+            const PixelUploadRing::Stats &uploads = TextureLoader::Instance().UploadStats();
+            printf("Texture uploads: %zu (%zu staged in pixel buffers), %.2f MB at %.1f MB/s, %.3f ms per upload on the %s "
+                   "thread, %.3f ms per level on the main thread\n", uploads.uploads, uploads.stagedUploads,
+                   uploads.bytes / 1048576.0, uploads.MegabytesPerSecond(), uploads.MillisecondsPerUpload(),
+                   UploadContext::Instance().Running() ? "loader" : "main",
+                   TextureLoader::Instance().MainThreadMillisecondsPerLevel());
+            TextureLoader::LoadTime skyboxTime = TextureLoader::Instance().GetLoadTime(cubemapTexture);
+            printf("Skybox: %.1f ms %s, resident %.1f ms after the request\n", skyboxTime.decodeMilliseconds,
+                   skyboxTime.baked ? "mapping the baked cubemap" : "decoding the faces", skyboxTime.residentMilliseconds);
+            AssetFileSystem::Stats &assets = AssetFileSystem::Instance().GetStats();
+            ProcessReads reads = currentProcessReads();
+            printf("Asset reads: %zu from the pack (%.2f MB), %zu mapped from disk (%.2f MB), %.2f MB copied out; "
+                   "%zu mapping and %zu stat system calls, %zu read() calls returning %.2f MB in the whole process\n",
+                   assets.packOpens.load(), assets.packBytes / 1048576.0, assets.diskOpens.load(), assets.diskBytes / 1048576.0,
+                   assets.copiedBytes / 1048576.0, MappedFile::SystemCalls().load(), assets.stampChecks.load(), reads.calls,
+                   reads.bytes / 1048576.0);
+            printf("Memory with the scene loaded: resident %.2f MB, peak %.2f MB\n", currentResidentBytes() / 1048576.0,
+                   peakResidentBytes() / 1048576.0);
+            steadyStateReported = true;
+        }
+
         // render
         // ------
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -314,30 +419,47 @@ int main() {
 
         // view/projection transformations
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
         glm::mat4 view = programState->camera.GetViewMatrix();
+        // pixels covered by one world unit at distance 1, for the level of detail selection; the framebuffer size
+        // follows resizes, the light clusters use it as well
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        float projectionScale = framebufferHeight / (2.0f * tan(glm::radians(programState->camera.Zoom) / 2.0f));
+        Model::FrameTriangles() = 0;
+
+        CameraBlock camera = {};
+        camera.projection = projection;
+        camera.view = view;
+        camera.skyboxView = glm::mat4(glm::mat3(view)); // remove translation from the view matrix
+        camera.skyboxView = glm::translate(camera.skyboxView, glm::vec3(0, -0.5f, 0));    //prikazi skybox malo nize
+        camera.viewPos = programState->camera.Position;
+        cameraBuffer.Update(camera);
+
+        // the Lights block holds the first MAX_LIGHTS lights, the clusters take them all
+        frameLights.assign(sceneLights.begin(), sceneLights.end());
+        AddStressLights(frameLights, programState->stressLights, currentFrame);
+        const LightingShaders &lighting = lightingShaders[programState->clusteredLighting];
+        if (programState->clusteredLighting) {
+            lightClusters.Build(frameLights, view, projection, NEAR_PLANE, FAR_PLANE, framebufferWidth,
+                                framebufferHeight);
+            lightClusters.Upload();
+            programState->clusterStats = lightClusters.GetStats();
+        } else {
+            LightsBlock lights = {};
+            for (const LightBlock &light : frameLights)
+                if (!lights.Add(light))
+                    break;
+            lightsBuffer.Update(lights);
+        }
+        Shader &advancedLightingShader = *lighting.opaque;
+        Shader &wallShader = *lighting.wall;
+        Shader &glassShader = *lighting.glass;
+        const int lightingModel = lighting.model;
 
 
         //model se postavlja u pomocnoj funkciji
         advancedLightingShader.use();
-
-        if (programState->ImGuiEnabled) {
-            advancedLightingShader.setVec3("spotLight.ambient", programState->spotLight.ambient);
-            advancedLightingShader.setVec3("spotLight.diffuse", programState->spotLight.diffuse);
-            advancedLightingShader.setVec3("spotLight.specular", programState->spotLight.specular);
-            advancedLightingShader.setFloat("spotLight.constant", programState->spotLight.constant);
-            advancedLightingShader.setFloat("spotLight.linear", programState->spotLight.linear);
-            advancedLightingShader.setFloat("spotLight.quadratic", programState->spotLight.quadratic);
-            advancedLightingShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(programState->spotLight.cutOff)));
-            advancedLightingShader.setFloat("spotLight.outerCutOff",
-                                            glm::cos(glm::radians(programState->spotLight.outerCutOff)));
-        }
-
-        advancedLightingShader.setInt("material.diffuseMap",0);    //ova 2 moraju u petlji jer ce za neke kocke koje se crtaju posle
-        advancedLightingShader.setInt("material.specularMap", 1);   //specularMap biti postavljeno na 0
-        advancedLightingShader.setMat4("projection", projection);
-        advancedLightingShader.setMat4("view", view);
-        advancedLightingShader.setVec3("viewPos", programState->camera.Position);
         //advancedLightingShader.setVec3("lightPos", glm::vec3(0, 3, 0));
 
 
@@ -347,14 +469,14 @@ int main() {
         //Modeli
         //----------------
 
-        advancedLightingShader.setInt("blending", 0);
 
         //MOAI
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(8, 0.75f + sin(currentFrame) * 0.5, 0));
         model = glm::rotate(model, glm::radians(50 * cos(currentFrame * 0.01f) * 360), glm::vec3(0, 1, 0));
         model = glm::scale(model, glm::vec3(0.0375f));
-        advancedLightingShader.setMat4("model", model);
+        advancedLightingShader.setMat4(lightingModel, model);
+        moai.SelectLod(model, programState->camera.Position, projectionScale);
         moai.Draw(advancedLightingShader);
 
 
@@ -363,7 +485,8 @@ int main() {
         model = glm::translate(model, glm::vec3(8, 0, 3.0f));
         model = glm::rotate(model, glm::radians(25 * cos(15 + currentFrame * 0.01f) * 360), glm::vec3(0, 1, 0));
         model = glm::scale(model, glm::vec3(0.025f));
-        advancedLightingShader.setMat4("model", model);
+        advancedLightingShader.setMat4(lightingModel, model);
+        lucy.SelectLod(model, programState->camera.Position, projectionScale);
         lucy.Draw(advancedLightingShader);
 
         //VENUS
@@ -371,7 +494,8 @@ int main() {
         model = glm::translate(model, glm::vec3(8, 0.1f, -3));
         model = glm::rotate(model, glm::radians(-10 * cos(45 + currentFrame * 0.01f) * 360), glm::vec3(0, 1, 0));
         model = glm::scale(model, glm::vec3(0.0185f));
-        advancedLightingShader.setMat4("model", model);
+        advancedLightingShader.setMat4(lightingModel, model);
+        venus.SelectLod(model, programState->camera.Position, projectionScale);
         venus.Draw(advancedLightingShader);
 
 
@@ -381,21 +505,21 @@ int main() {
         model = glm::translate(model, glm::vec3(8, 4.75f, -3));
         model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1, 0, 0));
         model = glm::scale(model, glm::vec3(3));
-        advancedLightingShader.setMat4("model", model);
+        advancedLightingShader.setMat4(lightingModel, model);
         spotlightObj.Draw(advancedLightingShader);
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(8, 4.75f, 0));
         model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1, 0, 0));
         model = glm::scale(model, glm::vec3(3));
-        advancedLightingShader.setMat4("model", model);
+        advancedLightingShader.setMat4(lightingModel, model);
         spotlightObj.Draw(advancedLightingShader);
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(8, 4.75f, 3));
         model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1, 0, 0));
         model = glm::scale(model, glm::vec3(3));
-        advancedLightingShader.setMat4("model", model);
+        advancedLightingShader.setMat4(lightingModel, model);
         spotlightObj.Draw(advancedLightingShader);
 
         //Ceiling lamp
@@ -403,16 +527,13 @@ int main() {
         model = glm::translate(model, glm::vec3(-4, 2.5f, 0));
         model = glm::rotate(model, glm::radians(0.0f), glm::vec3(1, 0, 0));
         model = glm::scale(model, glm::vec3(0.5));
-        advancedLightingShader.setMat4("model", model);
+        advancedLightingShader.setMat4(lightingModel, model);
         ceilingLamp.Draw(advancedLightingShader);
 
         //Light source for ceiling lamp
         ConfigureVAO(cubeVAO, cubeVBO, cubeVertices, sizeof(cubeVertices));
         lightSource.use();
-        lightSource.setMat4("projection", projection);
-        lightSource.setMat4("view", view);
-
-        lightSource.setVec3("color", glm::vec3(1, 1, 0));
+        lightSource.setVec3(lightSourceColor, glm::vec3(1, 1, 0));
 
         //Draw cube
         glBindVertexArray(cubeVAO);
@@ -421,7 +542,7 @@ int main() {
         model = glm::translate(model, glm::vec3(-4, 4.125f, 0));
         //rotate
         model = glm::scale(model, glm::vec3(0.2f, 0.75f, 0.2f));
-        lightSource.setMat4("model", model);
+        lightSource.setMat4(lightSourceModel, model);
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
 
@@ -432,29 +553,25 @@ int main() {
                   &floorSpecularMap);
 
         //Roof
-        SpawnCube(&advancedLightingShader, &wallDiffuseMap, &cubeVAO, glm::vec3(0, 5.0f, 0),
+        SpawnCube(&wallShader, &wallDiffuseMap, &cubeVAO, glm::vec3(0, 5.0f, 0),
                   glm::vec3(20.0f, 0.25f, 10.0f));
 
 
         //Pillars
         ConfigureVAO(cubeVAO, cubeVBO, cubeVertices, sizeof(cubeVertices));
-        SpawnCube(&advancedLightingShader, &wallDiffuseMap, &cubeVAO, glm::vec3(9.5f, 2.5f, 4.5f),
+        SpawnCube(&wallShader, &wallDiffuseMap, &cubeVAO, glm::vec3(9.5f, 2.5f, 4.5f),
                   glm::vec3(1.0f, 5.0f, 1.0f));
-        SpawnCube(&advancedLightingShader, &wallDiffuseMap, &cubeVAO, glm::vec3(9.5f, 2.5f, -4.5f),
+        SpawnCube(&wallShader, &wallDiffuseMap, &cubeVAO, glm::vec3(9.5f, 2.5f, -4.5f),
                   glm::vec3(1.0f, 5.0f, 1.0f));
-        SpawnCube(&advancedLightingShader, &wallDiffuseMap, &cubeVAO, glm::vec3(-9.5f, 2.5f, -4.5f),
+        SpawnCube(&wallShader, &wallDiffuseMap, &cubeVAO, glm::vec3(-9.5f, 2.5f, -4.5f),
                   glm::vec3(1.0f, 5.0f, 1.0f));
-        SpawnCube(&advancedLightingShader, &wallDiffuseMap, &cubeVAO, glm::vec3(-9.5f, 2.5f, 4.5f),
+        SpawnCube(&wallShader, &wallDiffuseMap, &cubeVAO, glm::vec3(-9.5f, 2.5f, 4.5f),
                   glm::vec3(1.0f, 5.0f, 1.0f));
 
 
         glDepthFunc(
                 GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        view = glm::translate(view, glm::vec3(0, -0.5f, 0));    //prikazi skybox malo nize
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
         // skybox cube
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
@@ -464,9 +581,6 @@ int main() {
         glDepthFunc(GL_LESS); // set depth function back to default
 
 
-        advancedLightingShader.use();
-        advancedLightingShader.setInt("blending", 1);
-
         //Prozori idu posle ostalih objekata zbog blendinga
         //Sortiraj prozore
         std::map<float, pair<glm::vec3, glm::vec3>> sorted;
@@ -479,7 +593,7 @@ int main() {
         //Crtaj pocevsi od najblizeg
         for (std::map<float, pair<glm::vec3, glm::vec3>>::reverse_iterator it = sorted.rbegin();
              it != sorted.rend(); ++it) {
-            SpawnCube(&advancedLightingShader, &glassDiffuseMap, &cubeVAO, it->second.first, it->second.second,
+            SpawnCube(&glassShader, &glassDiffuseMap, &cubeVAO, it->second.first, it->second.second,
                       &glassSpecularMap);
         }
 
@@ -487,10 +601,26 @@ int main() {
         if (programState->ImGuiEnabled)
             DrawImGui(programState);
 
+        frameCpuMilliseconds += frameTimer.Milliseconds();
+        if (++statsFrames == FRAME_STATS_FRAMES) {
+            programState->frameCpuMilliseconds = (float) (frameCpuMilliseconds / statsFrames);
+            programState->locationQueriesPerFrame = (float) (Shader::LocationQueries() - statsLocationQueries) / statsFrames;
+            programState->residentBytes = currentResidentBytes();
+            programState->peakBytes = peakResidentBytes();
+            frameCpuMilliseconds = 0.0;
+            statsFrames = 0;
+            statsLocationQueries = Shader::LocationQueries();
+        }
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+        if (!firstFrameReported) {
+            printf("First frame after %.1f ms, %zu textures still loading or streaming in their mips\n",
+                   startupTimer.Milliseconds(), TextureLoader::Instance().Pending());
+            firstFrameReported = true;
+        }
     }
 
 
@@ -501,6 +631,9 @@ int main() {
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &cubeVBO);
     glDeleteBuffers(1, &skyboxVBO);
+    cameraBuffer.Destroy();
+    lightsBuffer.Destroy();
+    lightClusters.Destroy();
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
@@ -512,10 +645,38 @@ int main() {
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
+    UploadContext::Instance().Stop();
     glfwTerminate();
     return 0;
 }
 
+// Blinn-Phong; blended for the glass, and without a specular map the diffuse map stands in
+ShaderVariant LightingVariant(bool blended, bool specularMap, bool clustered) {
+    return ShaderVariant()
+            .Define("BLINN", 1)
+            .Define("BLENDED", blended)
+            .Define("SPECULAR_MAP", specularMap)
+            .Define("CLUSTERED", clustered);
+}
+
+// small coloured point lights in a grid over the floor, bobbing around their places; each fades out within a couple
+// of metres, so with clusters a fragment only pays for the few near it
+void AddStressLights(vector<LightBlock> &lights, int count, float time) {
+    if (count <= 0)
+        return;
+    // twice as many columns as rows, like the floor
+    int columns = (int) std::ceil(std::sqrt(count * 2.0f));
+    int rows = (count + columns - 1) / columns;
+    for (int i = 0; i < count; i++) {
+        float phase = i * 2.4f;
+        glm::vec3 position(-9.0f + 18.0f * (i % columns + 0.5f) / columns + 0.3f * sin(time + phase),
+                           0.5f + 0.3f * sin(time * 1.3f + phase),
+                           -4.5f + 9.0f * (i / columns + 0.5f) / rows + 0.3f * cos(time + phase));
+        glm::vec3 color = glm::vec3(cos(phase), cos(phase + 2.1f), cos(phase + 4.2f)) * 0.5f + glm::vec3(0.5f);
+        lights.push_back(MakePointLight(position, glm::vec3(0), color * 0.6f, color * 0.3f, 1.0f, 1.0f, 30.0f));
+    }
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window) {
@@ -600,6 +761,51 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Textures");
+        TextureRegistry::Stats stats = TextureRegistry::Instance().GetStats();
+        ImGui::Text("Requests: %zu, unique textures: %zu", stats.requests, stats.textures);
+        ImGui::Text("Shared by path: %zu, by content: %zu", stats.pathHits, stats.contentHits);
+        ImGui::Text("Requests hashed on the main thread: %zu", stats.contentChecks);
+        ImGui::Text("Resident: %.2f MB, saved: %.2f MB", stats.residentBytes / 1048576.0, stats.savedBytes / 1048576.0);
+        ImGui::Text("Waiting for upload: %zu, streaming mips: %zu", TextureLoader::Instance().Pending(),
+                    TextureLoader::Instance().Streaming());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Frame");
+        ImGui::Text("CPU time: %.3f ms", programState->frameCpuMilliseconds);
+        ImGui::Text("Uniform location queries: %.1f per frame", programState->locationQueriesPerFrame);
+        ImGui::Checkbox("Cache uniform locations", &Shader::CacheUniformLocations());
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Lights");
+        ImGui::Checkbox("Clustered", &programState->clusteredLighting);
+        ImGui::SliderInt("Stress lights", &programState->stressLights, 0, MAX_STRESS_LIGHTS);
+        if (programState->clusteredLighting) {
+            const LightClusters::Stats &clusters = programState->clusterStats;
+            ImGui::Text("Lights: %zu, %zu of them in every cluster", clusters.lights, clusters.globalLights);
+            ImGui::Text("Cluster lists: %zu entries, longest %zu", clusters.indices, clusters.maxClusterLights);
+            ImGui::Text("Assignment: %.3f ms", clusters.milliseconds);
+        } else {
+            ImGui::Text("Only the first %d lights are lit", MAX_LIGHTS);
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Geometry");
+        ImGui::Text("Model triangles this frame: %zu", Model::FrameTriangles());
+        ImGui::DragFloat("LOD pixel error", &Model::LodPixelError(), 0.05, 0.0, 16.0);
+        ImGui::DragFloat("LOD hysteresis", &Model::LodHysteresis(), 0.01, 0.0, 0.9);
+        ImGui::Text("Resident: %.2f MB, peak: %.2f MB", programState->residentBytes / 1048576.0,
+                    programState->peakBytes / 1048576.0);
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -0,0 +1,147 @@
+// Texture bake tool. Converts source images into block compressed KTX files with all mip levels, which
+// TextureLoader uploads instead of decoding the source (see KtxFile.h). Run it from the repository root:
+//   ./project_base_bake [--force] [file or directory...]
+// Without arguments it bakes everything under resources/textures and resources/objects. Every image is baked in
+// both orientations, since TextureLoader::FlipVertically can be set either way when it is loaded. A directory with
+// the faces xpos, xneg, ypos, yneg, zpos and zneg (same extension) is baked as one cubemap file instead, unflipped
+// like the skybox loads it.
+
+#include <TextureBaker.h>
+#include <Timer.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+bool isImage(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string extension = path.substr(dot + 1);
+    for (char &c : extension)
+        c = (char) tolower(c);
+    return extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "tga" || extension == "bmp";
+}
+
+// the six faces of a cubemap in a directory, in TextureLoader::LoadCubemap order, if they are all there
+bool findCubemap(const std::string &directory, const std::vector<std::string> &entries, std::vector<std::string> &faces) {
+    static const char *names[6] = {"xpos", "xneg", "ypos", "yneg", "zpos", "zneg"};
+    for (const std::string &entry : entries) {
+        if (entry.compare(directory.size() + 1, 5, "xpos.") != 0 || !isImage(entry))
+            continue;
+        std::string extension = entry.substr(entry.find_last_of('.'));
+        faces.clear();
+        for (const char *name : names) {
+            std::string face = directory + '/' + name + extension;
+            if (std::find(entries.begin(), entries.end(), face) == entries.end())
+                break;
+            faces.push_back(face);
+        }
+        if (faces.size() == 6)
+            return true;
+    }
+    return false;
+}
+
+void collectImages(const std::string &path, std::vector<std::string> &images, std::vector<std::vector<std::string>> &cubemaps) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return;
+    if (!S_ISDIR(info.st_mode)) {
+        if (isImage(path))
+            images.push_back(path);
+        return;
+    }
+    DIR *directory = opendir(path.c_str());
+    if (!directory)
+        return;
+    std::vector<std::string> entries;
+    while (dirent *entry = readdir(directory)) {
+        if (entry->d_name[0] != '.')
+            entries.push_back(path + '/' + entry->d_name);
+    }
+    closedir(directory);
+    std::sort(entries.begin(), entries.end());
+    std::vector<std::string> faces;
+    if (findCubemap(path, entries, faces)) {
+        cubemaps.push_back(faces);
+        for (const std::string &face : faces)
+            entries.erase(std::find(entries.begin(), entries.end(), face));
+    }
+    for (const std::string &entry : entries)
+        collectImages(entry, images, cubemaps);
+}
+
+const char *formatName(uint32_t internalFormat) {
+    if (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+        return "BC1";
+    if (internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        return "BC3";
+    return "BC4";
+}
+
+int main(int argc, char **argv) {
+    bool force = false;
+    std::vector<std::string> roots;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--force") == 0)
+            force = true;
+        else
+            roots.push_back(argv[i]);
+    }
+    if (roots.empty())
+        roots = {"resources/textures", "resources/objects"};
+
+    std::vector<std::string> images;
+    std::vector<std::vector<std::string>> cubemaps;
+    for (const std::string &root : roots)
+        collectImages(root, images, cubemaps);
+
+    // a single image in both orientations, or the faces of a cubemap
+    struct BakeJob {
+        std::vector<std::string> sources;
+        bool flip;
+        std::string name;
+    };
+    std::vector<BakeJob> jobs;
+    for (const std::string &path : images)
+        for (int flip = 0; flip < 2; flip++)
+            jobs.push_back(BakeJob{std::vector<std::string>{path}, flip != 0, path});
+    for (const std::vector<std::string> &faces : cubemaps)
+        jobs.push_back(BakeJob{faces, false, faces[0].substr(0, faces[0].find_last_of('/')) + " (cubemap)"});
+
+    Timer total;
+    size_t uncompressedBytes = 0, bakedBytes = 0;
+    int baked = 0, skipped = 0, failed = 0;
+    for (const BakeJob &job : jobs) {
+        KtxFile existing;
+        if (!force && existing.OpenBaked(job.sources, job.flip)) {
+            skipped++;
+            continue;
+        }
+        Timer timer;
+        TextureBakeResult result = job.sources.size() == 6 ? BakeCubemap(job.sources, job.flip) : BakeTexture(job.sources[0], job.flip);
+        if (!result.ok) {
+            printf("  %-60s FAILED\n", job.name.c_str());
+            failed++;
+            continue;
+        }
+        baked++;
+        if (!job.flip) {
+            uncompressedBytes += result.uncompressedBytes;
+            bakedBytes += result.bakedBytes;
+        }
+        printf("  %-60s %s %5dx%-5d %s %s %8.2f MB -> %6.2f MB %8.1f ms\n", job.name.c_str(), formatName(result.internalFormat),
+               result.width, result.height, job.flip ? "flipped" : "       ", result.gammaAware ? "srgb  " : "linear",
+               result.uncompressedBytes / 1048576.0, result.bakedBytes / 1048576.0, timer.Milliseconds());
+    }
+    printf("baked %d, up to date %d, failed %d in %.1f ms; %.2f MB of uncompressed textures as %.2f MB\n", baked, skipped,
+           failed, total.Milliseconds(), uncompressedBytes / 1048576.0, bakedBytes / 1048576.0);
+    return failed > 0 ? 1 : 0;
+}
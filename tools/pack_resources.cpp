@@ -0,0 +1,74 @@
+// Resource pack tool. Concatenates assets into the single file AssetFileSystem maps at startup (see ResourcePack.h).
+// Run it from the repository root, after project_base_bake and after the main executable has written its caches:
+//   ./project_base_pack [--output pack] [file or directory...]
+// Without arguments it packs the shaders, the mesh cache and the baked textures into resources/cache/resources.pack.
+// Source models and images stay loose, the cached and baked files are what the loaders read when they are current.
+
+#include <AssetFileSystem.h>
+#include <ResourcePack.h>
+#include <Timer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+void collectFiles(const std::string &path, const std::string &output, std::vector<std::string> &files) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return;
+    if (!S_ISDIR(info.st_mode)) {
+        // half written files of the other tools and the pack itself
+        bool temporary = path.size() > 4 && path.compare(path.size() - 4, 4, ".tmp") == 0;
+        if (S_ISREG(info.st_mode) && !temporary && path != output)
+            files.push_back(path);
+        return;
+    }
+    DIR *directory = opendir(path.c_str());
+    if (!directory)
+        return;
+    std::vector<std::string> entries;
+    while (dirent *entry = readdir(directory)) {
+        if (entry->d_name[0] != '.')
+            entries.push_back(path + '/' + entry->d_name);
+    }
+    closedir(directory);
+    std::sort(entries.begin(), entries.end());
+    for (const std::string &entry : entries)
+        collectFiles(entry, output, files);
+}
+
+int main(int argc, char **argv) {
+    std::string output = AssetFileSystem::DefaultPackPath();
+    std::vector<std::string> roots;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+            roots.push_back(argv[i]);
+    }
+    if (roots.empty())
+        roots = {"resources/shaders", "resources/cache/meshes", "resources/cache/textures"};
+
+    std::vector<std::string> files;
+    for (const std::string &root : roots)
+        collectFiles(root, output, files);
+
+    Timer timer;
+    if (files.empty() || !ResourcePack::Write(output, files)) {
+        printf("failed to write %s from %zu files\n", output.c_str(), files.size());
+        return 1;
+    }
+    ResourcePack pack;
+    if (!pack.Open(output)) {
+        printf("%s was written but can't be read back\n", output.c_str());
+        return 1;
+    }
+    printf("packed %zu files into %s, %.2f MB in %.1f ms\n", pack.Size(), output.c_str(), pack.Bytes() / 1048576.0,
+           timer.Milliseconds());
+    return 0;
+}